@@ -13,6 +13,7 @@ open Ccodegen_decode_procedure
 open Ccodegen_stringifier
 open Ccodegen_instr_types
 open Ccodegen_operand_info
+open Ccodegen_packed_ast
 
 open Printexc
 
@@ -75,6 +76,36 @@ let () = print_endline ("SAIL PATH : " ^ sailpath)
 
 let paths_filename = ref ""
 
+let decode_as_tree = ref false
+
+let hart_profile_filename = ref ""
+
+let compressed_table = ref false
+
+let rule_frequencies_filename = ref ""
+
+let decode_report_filename = ref ""
+
+let dense_mapbinds = ref false
+
+let decode_id = ref false
+
+let control_flow = ref false
+
+let operand_columns = ref false
+
+let packed_ast = ref false
+
+let decode_stats = ref false
+
+let literal_appends = ref false
+
+let mnemonic_tables = ref false
+
+let format_templates = ref false
+
+let ast2str_buf = ref false
+
 let usage_msg = "Usage: riscv_disasm_from_sail -f <path-to-list-of-input-files>"
 let arg_spec =
   [
@@ -82,6 +113,80 @@ let arg_spec =
       Arg.Set_string paths_filename,
       "Path to a file containing a list of input files, a filename on each line"
     );
+    ( "-decode-tree",
+      Arg.Set decode_as_tree,
+      "Generate the decoders as nested switches on the fixed bits of the rules \
+       instead of trying each rule in order"
+    );
+    ( "-profile",
+      Arg.Set_string hart_profile_filename,
+      "Path to a hart profile (see conf/profiles), specialises the generated \
+       code to harts matching it"
+    );
+    ( "-compressed-table",
+      Arg.Set compressed_table,
+      "Also generate a 64K-entry lookup table decoder for compressed \
+       instructions, built once per context"
+    );
+    ( "-rule-frequencies",
+      Arg.Set_string rule_frequencies_filename,
+      "Path to a file of ast case names and how often they occur, moves the \
+       rules of frequent cases ahead of the rules they can't overlap with"
+    );
+    ( "-decode-report",
+      Arg.Set_string decode_report_filename,
+      "Path to write an analysis of the decode rules to : dead rules, rules \
+       that can be reordered and the worst-case number of rules tried per case"
+    );
+    ( "-dense-mapbinds",
+      Arg.Set dense_mapbinds,
+      "Generate the mappings of short slices to enums and structs as static \
+       arrays indexed by the slice instead of switches"
+    );
+    ( "-decode-id",
+      Arg.Set decode_id,
+      "Also generate decode_id(), which only returns the instruction id and \
+       length of an instruction without extracting its fields"
+    );
+    ( "-control-flow",
+      Arg.Set control_flow,
+      "Also generate decoders that only recognise the control-flow \
+       instructions listed in conf/control-flow/cases.txt"
+    );
+    ( "-operand-columns",
+      Arg.Set operand_columns,
+      "Also generate fill_operand_roles(), which gives the register operands \
+       of every instruction fixed roles (rd, rs1, rs2, rs3) for columnar output"
+    );
+    ( "-packed-ast",
+      Arg.Set packed_ast,
+      "Also generate a representation of the ast packed into a single uint64_t"
+    );
+    ( "-decode-stats",
+      Arg.Set decode_stats,
+      "Instrument the decoders with counters of the rules tried, guard calls \
+       and unmatched inputs, compiled in when RISCV_DECODE_STATS is defined"
+    );
+    ( "-literal-appends",
+      Arg.Set literal_appends,
+      "Make ast2str append literals with their length known, merging adjacent \
+       ones, instead of through SStream_concat format strings"
+    );
+    ( "-mnemonic-tables",
+      Arg.Set mnemonic_tables,
+      "Generate the enum and bitvector to string mappings of ast2str as arrays \
+       of offsets into a single string pool instead of switches"
+    );
+    ( "-format-templates",
+      Arg.Set format_templates,
+      "Lower the assembly of each instruction into a template of literals and \
+       operand slots, rendered by RISCVAst2StrTemplates.h in a single pass"
+    );
+    ( "-ast2str-buf",
+      Arg.Set ast2str_buf,
+      "Also generate ast2str_buf(), which renders the templates of \
+       -format-templates into a buffer of the caller, without an SStream"
+    );
   ]
 let anon_arg_handler a =
   print_endline ("Unrecognized argument " ^ a ^ ", ignoring...")
@@ -111,18 +216,75 @@ let ctypedefs_str = stringify_typdef ctypedefs
 
 let analysis = Sail_analysis.analyze ast types
 
-let dec = gen_decoder ast_decode_mapping ast analysis
+let hart_profile =
+  if !hart_profile_filename = "" then None
+  else Some (Hart_profile.read_profile !hart_profile_filename)
 
-let compressed_dec = gen_decoder ast_compressed_decode_mapping ast analysis
+let rule_frequencies =
+  if !rule_frequencies_filename = "" then None
+  else Some (Decode_order.read_rule_frequencies !rule_frequencies_filename)
 
-let dec_str = decoder_to_c dec typdefwalker
+let specialize_decoder decoder =
+  match hart_profile with
+  | Some profile -> Hart_profile.specialize_decoder profile decoder
+  | None -> decoder
 
-let compressed_dec_str =
-  decoder_to_c ~c_proc_name:"decode_compressed" compressed_dec typdefwalker
+let prepare_decoder decoder =
+  let decoder = Decode_analysis.drop_dead_rules decoder in
+  match rule_frequencies with
+  | Some frequencies -> Decode_order.order_by_frequency frequencies decoder
+  | None -> decoder
+
+let model_dec = specialize_decoder (gen_decoder ast_decode_mapping ast analysis)
+
+let model_compressed_dec =
+  specialize_decoder (gen_decoder ast_compressed_decode_mapping ast analysis)
 
-let asm = gen_stringifier ast analysis
+let dec = prepare_decoder model_dec
 
-let asm_str, tables_str = assembler_to_c asm typdefwalker
+let compressed_dec = prepare_decoder model_compressed_dec
+
+let () =
+  if !decode_report_filename <> "" then (
+    let oc = open_out !decode_report_filename in
+    output_string oc
+      (Decode_analysis.report ~as_tree:!decode_as_tree "decode" model_dec dec);
+    output_string oc
+      (Decode_analysis.report ~as_tree:!decode_as_tree "decode_compressed"
+         model_compressed_dec compressed_dec
+      );
+    close_out oc
+  )
+
+let produced_cases = Hart_profile.produced_cases [dec; compressed_dec]
+
+let dec_str =
+  decoder_to_c ~as_tree:!decode_as_tree ~dense_mapbinds:!dense_mapbinds
+    ~decode_stats:!decode_stats dec typdefwalker
+
+let compressed_dec_str =
+  let table_str =
+    if !compressed_table then
+      decoder_table_to_c ~c_proc_name:"decode_compressed"
+        ~dense_mapbinds:!dense_mapbinds ~decode_stats:!decode_stats
+        ~index_bits:16 compressed_dec typdefwalker
+    else ""
+  in
+  decoder_to_c ~c_proc_name:"decode_compressed" ~as_tree:!decode_as_tree
+    ~dense_mapbinds:!dense_mapbinds ~decode_stats:!decode_stats compressed_dec
+    typdefwalker
+  ^ table_str
+
+let asm =
+  let asm = gen_stringifier ast analysis in
+  if Option.is_some hart_profile then
+    Hart_profile.specialize_stringifier produced_cases asm
+  else asm
+
+let asm_str, ast2str_pool_str, tables_str, ast2str_buf_str =
+  assembler_to_c ~literal_appends:!literal_appends
+    ~mnemonic_tables:!mnemonic_tables ~format_templates:!format_templates
+    ~ast2str_buf:!ast2str_buf asm typdefwalker
 
 let gen_instr_types_conf =
   Gen_instr_types.read_config "conf/instruction-types/excluded_enums.txt"
@@ -132,16 +294,31 @@ let instr_types = Gen_instr_types.gen_instr_types analysis gen_instr_types_conf
 let instr_types_str, instr_types_mapping_str =
   instr_types_to_c instr_types typdefwalker
 
-let info = Gen_operand_info.gen_operand_info ast analysis
-let info_str = operand_info_to_c info typdefwalker
+let info =
+  let info = Gen_operand_info.gen_operand_info ast analysis in
+  if Option.is_some hart_profile then
+    Hart_profile.specialize_operand_info produced_cases info
+  else info
+let info_str =
+  operand_info_to_c info typdefwalker
+  ^ if !operand_columns then operand_roles_to_c info typdefwalker else ""
 
 let () = write_c_file ast_type_filename ctypedefs_str
+let () =
+  if !packed_ast then (
+    let layout = Packed_ast.gen_packed_layout ctypedefs in
+    write_c_file packed_ast_filename (packed_ast_to_c layout)
+      ~additional_includes:[ast_type_filename]
+  )
+let decode_includes =
+  [ast_type_filename; "RISCVDecodeHelpers.h"]
+  @ if !decode_stats then ["RISCVDecodeStats.h"] else []
 let () =
   write_c_file decode_logic_filename dec_str
-    ~additional_includes:[ast_type_filename; "RISCVDecodeHelpers.h"]
+    ~additional_includes:decode_includes
 let () =
   write_c_file compressed_decode_logic_filename compressed_dec_str
-    ~additional_includes:[ast_type_filename; "RISCVDecodeHelpers.h"]
+    ~additional_includes:decode_includes
 let () =
   write_c_file assembler_filename asm_str
     ~additional_includes:
@@ -152,9 +329,28 @@ let () =
         "../../SStream.h";
       ]
 
+(* The tables are then pooled, and append through the helpers *)
+let pooled_ast2str = !mnemonic_tables || !format_templates || !ast2str_buf
+
+let ast2str_tables_includes =
+  [ast_type_filename; "../../SStream.h"]
+  @ (if !literal_appends || pooled_ast2str then ["RISCVAst2StrHelpers.h"]
+     else [])
+  @ (if !format_templates || !ast2str_buf then ["RISCVAst2StrTemplates.h"]
+     else [])
+  @ if pooled_ast2str then [ast2str_pool_filename] else []
+
+let () =
+  if pooled_ast2str then
+    write_c_file ast2str_pool_filename ast2str_pool_str
+      ~additional_includes:[ast_type_filename; "RISCVAst2StrRender.h"]
 let () =
   write_c_file ast2str_tables_filename tables_str
-    ~additional_includes:[ast_type_filename; "../../SStream.h"]
+    ~additional_includes:ast2str_tables_includes
+let () =
+  if !ast2str_buf then
+    write_c_file ast2str_buf_filename ast2str_buf_str
+      ~additional_includes:[ast_type_filename; ast2str_pool_filename]
 
 let () = write_c_file instr_types_filename instr_types_str
 
@@ -162,6 +358,48 @@ let () =
   write_c_file instr_types_mapping_filename instr_types_mapping_str
     ~additional_includes:[instr_types_filename]
 
+let () =
+  if !decode_id then (
+    let decode_id_str =
+      decode_id_to_c
+        ~decoder_id_c:
+          (decoder_id_to_c ~as_tree:!decode_as_tree
+             ~dense_mapbinds:!dense_mapbinds dec typdefwalker instr_types
+          )
+        ~compressed_decoder_id_c:
+          (decoder_id_to_c ~c_proc_name:"decode_compressed"
+             ~as_tree:!decode_as_tree ~dense_mapbinds:!dense_mapbinds
+             compressed_dec typdefwalker instr_types
+          )
+    in
+    write_c_file decode_id_filename decode_id_str
+      ~additional_includes:
+        [
+          ast_type_filename;
+          instr_types_mapping_filename;
+          "RISCVDecodeHelpers.h";
+        ]
+  )
+
+let () =
+  if !control_flow then (
+    let cases =
+      Control_flow.read_control_flow_cases "conf/control-flow/cases.txt"
+    in
+    let control_flow_str =
+      slice_macros
+      ^ control_flow_decoder_to_c
+          (Control_flow.control_flow_rules cases dec)
+          typdefwalker
+      ^ control_flow_decoder_to_c ~c_proc_name:"decode_compressed"
+          (Control_flow.control_flow_rules cases compressed_dec)
+          typdefwalker
+      ^ control_flow_cases_to_c cases
+    in
+    write_c_file control_flow_filename control_flow_str
+      ~additional_includes:[ast_type_filename; "RISCVDecodeHelpers.h"]
+  )
+
 let () =
   write_c_file operands_filename info_str
     ~additional_includes:
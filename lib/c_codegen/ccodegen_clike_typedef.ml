@@ -3,7 +3,7 @@ open Capstone_autosync_sail
 open Clike_typedef
 open Constants
 
-let stringify_clike_builin name builtin =
+let clike_builtin_c_type builtin =
   match builtin with
   | Clike_bitfield size ->
       let pow2_rounded_size =
@@ -12,13 +12,18 @@ let stringify_clike_builin name builtin =
         else if size < 32 then 32
         else 64
       in
-      "uint"
-      ^ string_of_int pow2_rounded_size
-      ^ "_t " ^ name ^ " /* bits : " ^ string_of_int size ^ " */;"
-  | Clike_byte -> "uint8_t " ^ name ^ ";"
-  | Clike_word -> "uint16_t " ^ name ^ ";"
-  | Clike_dword -> "uint32_t " ^ name ^ ";"
-  | Clike_qword -> "uint64_t " ^ name ^ ";"
+      "uint" ^ string_of_int pow2_rounded_size ^ "_t"
+  | Clike_byte -> "uint8_t"
+  | Clike_word -> "uint16_t"
+  | Clike_dword -> "uint32_t"
+  | Clike_qword -> "uint64_t"
+
+let stringify_clike_builin name builtin =
+  match builtin with
+  | Clike_bitfield size ->
+      clike_builtin_c_type builtin
+      ^ " " ^ name ^ " /* bits : " ^ string_of_int size ^ " */;"
+  | _ -> clike_builtin_c_type builtin ^ " " ^ name ^ ";"
 
 let rec stringify_clike_typedef clike_typdef =
   match clike_typdef with
@@ -2,16 +2,48 @@ open Capstone_autosync_sail
 
 open Sail_values
 open Decoder
+open Decode_bits
+open Decode_tree
 open Constants
 open Gen_clike_typedef
+open Gen_instr_types
 open Utils
 
 type decproc_stringification_state = {
   typedef_walker : typedef_walker;
   currently_defined_bv_sizes : (string, int) Hashtbl.t;
+  fuse_asserts : bool;
+  (* Whether map-binds over short slices look their value up in a static array
+     instead of switching on the slice, see gen_c_dense_mapbind *)
+  dense_mapbinds : bool;
+  (* The arrays emitted so far, by their initializer, so that the map-binds of
+     several rules share the same array *)
+  dense_tables : (string, string) Hashtbl.t;
+  dense_tables_c_code : Buffer.t;
+  dense_table_prefix : string;
+  (* When set, rules return the C expression this gives for their instruction
+     id instead of building an ast node, see decoder_id_to_c *)
+  insn_id_of_rule : (decode_rule -> string) option;
+  (* Whether rules are instrumented with the DECODE_STATS_* macros of
+     RISCVDecodeStats.h, see decoder_to_c *)
+  decode_stats : bool;
 }
 
-let gen_c_consequences state consequences =
+let mk_state ?(fuse_asserts = false) ?(dense_mapbinds = false)
+    ?(dense_table_prefix = "") ?insn_id_of_rule ?(decode_stats = false) walker =
+  {
+    typedef_walker = walker;
+    currently_defined_bv_sizes = Hashtbl.create 100;
+    fuse_asserts;
+    dense_mapbinds;
+    dense_tables = Hashtbl.create 100;
+    dense_tables_c_code = Buffer.create 10000;
+    dense_table_prefix;
+    insn_id_of_rule;
+    decode_stats;
+  }
+
+let gen_c_consequences ?(return_c_stmt = "return;") state consequences =
   let gen_c_single_consequence_item conseq =
     let member_path = Option.get (walk state.typedef_walker) in
     let member_rhs =
@@ -33,8 +65,8 @@ let gen_c_consequences state consequences =
               let e =
                 match v with
                 | Bv_const c ->
-                    len_consumed := !len_consumed + ((String.length c - 2) * 4);
-                    c
+                    len_consumed := !len_consumed + sized_bitv_str_width c;
+                    sized_bitv_str_to_c c
                 | Binding s ->
                     len_consumed :=
                       !len_consumed
@@ -61,23 +93,7 @@ let gen_c_consequences state consequences =
   let items_set_stmt =
     String.concat ";" (List.map gen_c_single_consequence_item items)
   in
-  case_set_stmt ^ items_set_stmt ^ ";return;"
-
-let annotate_conds_with_start_offsets conditions =
-  let result = ref [] in
-  let len_consumed_so_far = ref 0 in
-  List.iter
-    (fun cond ->
-      match cond with
-      | Assert (len, _)
-      | Bind (len, _)
-      | Map_bind (len, _, _)
-      | Struct_map_bind (len, _, _, _) ->
-          result := (!len_consumed_so_far, cond) :: !result;
-          len_consumed_so_far := !len_consumed_so_far + len
-    )
-    conditions;
-  List.rev !result
+  case_set_stmt ^ items_set_stmt ^ ";" ^ return_c_stmt
 
 let gen_c_assert (start_offset, condition) =
   match condition with
@@ -90,6 +106,22 @@ let gen_c_assert (start_offset, condition) =
         )
   | _ -> None
 
+(* Folds all the Assert conditions of a rule into a single mask and compare.
+   Only used once a decode tree has dispatched on the input : in a linear chain
+   of rules, C compilers merge the identical slice compares of consecutive rules
+   into jump tables, which distinct per-rule masks defeat *)
+let gen_c_fixed_bits_test rule =
+  let mask, bits = fixed_bits rule in
+  let hex_digits = (rule_length rule + 3) / 4 in
+  if mask = 0 then None
+  else
+    Some
+      ("(" ^ binary_stream_c_parameter ^ " & "
+      ^ Printf.sprintf "0x%0*X" hex_digits mask
+      ^ ") == "
+      ^ Printf.sprintf "0x%0*X" hex_digits bits
+      )
+
 let gen_c_bind state (start_offset, condition) =
   match condition with
   | Bind (len, var) ->
@@ -102,8 +134,125 @@ let gen_c_bind state (start_offset, condition) =
         )
   | _ -> None
 
-let gen_c_mapbind (start_offset, condition) =
+let c_value_of_value v =
+  match v with
+  | Bool_const c -> if c then "1" else "0"
+  | Bv_const s | Binding s -> s
+  | Enum_lit s -> add_prefix_unless_exists identifier_prefix s
+
+(* Only slices this short get an array, longer ones would make for mostly
+   empty arrays *)
+let max_dense_mapbind_len = 6
+
+let dense_invalid_enum = "0xFFFF"
+
+(* Returns the name of an array with the given element type and initializer,
+   emitting it if no earlier map-bind needed the same one *)
+let dense_table state elem_type initializer_c =
+  let definition = elem_type ^ "{" ^ initializer_c ^ "}" in
+  match Hashtbl.find_opt state.dense_tables definition with
+  | Some name -> name
+  | None ->
+      let name =
+        state.dense_table_prefix ^ "_mapbind_"
+        ^ string_of_int (Hashtbl.length state.dense_tables)
+      in
+      Hashtbl.add state.dense_tables definition name;
+      Buffer.add_string state.dense_tables_c_code
+        ("static const " ^ elem_type ^ " " ^ name ^ "[] = {" ^ initializer_c
+       ^ "};\n"
+        );
+      name
+
+(* The same lookup as gen_c_mapbind, as a load from an array indexed by the
+   slice : an enum with an invalid marker for the values missing from the
+   mapping, or a struct along with an array of validity flags *)
+let gen_c_dense_mapbind ?(validity_only = false) state (start_offset, condition)
+    =
+  let slice_c_expr len =
+    "SLICE_BITVEC(" ^ binary_stream_c_parameter ^ " , "
+    ^ string_of_int start_offset ^ " , "
+    ^ string_of_int (start_offset + len - 1)
+    ^ ")"
+  in
+  let entries len tbl =
+    List.init (1 lsl len) (fun key ->
+        Hashtbl.fold
+          (fun bval value found ->
+            if int_of_string bval = key then Some value else found
+          )
+          tbl None
+    )
+  in
+  match condition with
+  | Map_bind (len, bv2enum_table, var) ->
+      let initializer_c =
+        entries len bv2enum_table
+        |> List.map (function
+             | Some enumval ->
+                 add_prefix_unless_exists identifier_prefix enumval
+             | None -> dense_invalid_enum
+             )
+        |> String.concat ","
+      in
+      let table = dense_table state "uint16_t" initializer_c in
+      Some
+        ("uint64_t " ^ var ^ " = " ^ table ^ "[" ^ slice_c_expr len ^ "]; if ("
+       ^ var ^ " != " ^ dense_invalid_enum ^ ") {"
+        )
+  | Struct_map_bind (len, _, bv2struct_table, _) when validity_only ->
+      let valid_c =
+        entries len bv2struct_table
+        |> List.map (fun e -> if Option.is_some e then "1" else "0")
+        |> String.concat ","
+      in
+      let valid_table = dense_table state "uint8_t" valid_c in
+      Some ("if (" ^ valid_table ^ "[" ^ slice_c_expr len ^ "]) {")
+  | Struct_map_bind (len, struct_typename, bv2struct_table, var) ->
+      let struct_entries = entries len bv2struct_table in
+      let values_c =
+        struct_entries
+        |> List.map (function
+             | Some kv_pairs ->
+                 "{"
+                 ^ String.concat ","
+                     (List.map
+                        (fun (k, v) -> "." ^ k ^ " = " ^ c_value_of_value v)
+                        kv_pairs
+                     )
+                 ^ "}"
+             | None -> "{0}"
+             )
+        |> String.concat ","
+      in
+      let valid_c =
+        struct_entries
+        |> List.map (fun e -> if Option.is_some e then "1" else "0")
+        |> String.concat ","
+      in
+      let table = dense_table state ("struct " ^ struct_typename) values_c in
+      let valid_table = dense_table state "uint8_t" valid_c in
+      Some
+        ("if (" ^ valid_table ^ "[" ^ slice_c_expr len ^ "]) { struct "
+       ^ struct_typename ^ " " ^ var ^ " = " ^ table ^ "[" ^ slice_c_expr len
+       ^ "];"
+        )
+  | _ -> None
+
+(* The entries of a map-bind table in the order of their keys, so that the
+   generated switches don't depend on the order of the hash table *)
+let bindings_by_key tbl =
+  List.sort
+    (fun (a, _) (b, _) -> compare (int_of_string a) (int_of_string b))
+    (List.of_seq (Hashtbl.to_seq tbl))
+
+(* With [validity_only], a struct map-bind only checks that the slice is one of
+   the keys of its mapping, without declaring the struct *)
+let gen_c_mapbind ?(validity_only = false) state (start_offset, condition) =
   match condition with
+  | (Map_bind (len, _, _) | Struct_map_bind (len, _, _, _))
+    when state.dense_mapbinds && len <= max_dense_mapbind_len ->
+      gen_c_dense_mapbind ~validity_only state (start_offset, condition)
   | Map_bind (len, bv2enum_table, var) ->
       let end_offset = start_offset + len - 1 in
       let init =
@@ -114,21 +263,30 @@ let gen_c_mapbind (start_offset, condition) =
         ^ string_of_int start_offset ^ " , " ^ string_of_int end_offset
         ^ ")) { "
       in
-      let c_cases = ref [] in
-      Hashtbl.iter
-        (fun bval enumval ->
-          let c_case =
-            "case " ^ bval ^ ": " ^ var ^ " = "
-            ^ add_prefix_unless_exists identifier_prefix enumval
-            ^ ";break; "
-          in
-          c_cases := c_case :: !c_cases
-        )
-        bv2enum_table;
+      let c_cases =
+        bindings_by_key bv2enum_table
+        |> List.map (fun (bval, enumval) ->
+               "case " ^ bval ^ ": " ^ var ^ " = "
+               ^ add_prefix_unless_exists identifier_prefix enumval
+               ^ ";break; "
+           )
+      in
       Some
-        (init ^ switch_start ^ String.concat "" !c_cases ^ "} if (" ^ var
+        (init ^ switch_start ^ String.concat "" c_cases ^ "} if (" ^ var
        ^ "!= 0x" ^ "FFFF" ^ "FFFF" ^ "FFFF" ^ "FFFF) {"
         )
+  | Struct_map_bind (len, _, bv2struct_table, var) when validity_only ->
+      let end_offset = start_offset + len - 1 in
+      let c_cases =
+        bindings_by_key bv2struct_table
+        |> List.map (fun (bval, _) -> "case " ^ bval ^ ": ")
+      in
+      Some
+        ("uint8_t " ^ var ^ "_is_valid = 0 ;" ^ "switch (SLICE_BITVEC("
+       ^ binary_stream_c_parameter ^ " , " ^ string_of_int start_offset ^ " , "
+       ^ string_of_int end_offset ^ ")) { " ^ String.concat "" c_cases ^ var
+       ^ "_is_valid = 1 ; " ^ "break; " ^ "} if (" ^ var ^ "_is_valid == 1) {"
+        )
   | Struct_map_bind (len, struct_typename, bv2struct_table, var) ->
       let end_offset = start_offset + len - 1 in
       let var_decl =
@@ -140,43 +298,39 @@ let gen_c_mapbind (start_offset, condition) =
         ^ string_of_int start_offset ^ " , " ^ string_of_int end_offset
         ^ ")) { "
       in
-      let c_cases = ref [] in
-      Hashtbl.iter
-        (fun bval kv_pairs ->
-          let member_assignments =
-            kv_pairs
-            |> List.map (fun (k, v) ->
-                   var ^ "." ^ k ^ " = "
-                   ^ ( match v with
-                     | Bool_const c -> if c then "1" else "0"
-                     | Bv_const s | Binding s -> s
-                     | Enum_lit s ->
-                         add_prefix_unless_exists identifier_prefix s
-                     )
-                   ^ ";"
-               )
-          in
-          let c_case =
-            "case " ^ bval ^ ": "
-            ^ String.concat "" member_assignments
-            ^ var ^ "_is_valid = 1 ; " ^ "break; "
-          in
-          c_cases := c_case :: !c_cases
-        )
-        bv2struct_table;
+      let c_cases =
+        bindings_by_key bv2struct_table
+        |> List.map (fun (bval, kv_pairs) ->
+               let member_assignments =
+                 kv_pairs
+                 |> List.map (fun (k, v) ->
+                        var ^ "." ^ k ^ " = " ^ c_value_of_value v ^ ";"
+                    )
+               in
+               "case " ^ bval ^ ": "
+               ^ String.concat "" member_assignments
+               ^ var ^ "_is_valid = 1 ; " ^ "break; "
+           )
+      in
       Some
-        (var_decl ^ switch_start ^ String.concat "" !c_cases ^ "} if (" ^ var
+        (var_decl ^ switch_start ^ String.concat "" c_cases ^ "} if (" ^ var
        ^ "_is_valid == 1) {"
         )
   | _ -> None
 
-let rec gen_c_guards cond bound_ids currently_defined_bv_sizes =
+(* With [count_calls], every call to a helper function is wrapped in
+   DECODE_STATS_GUARD() *)
+let rec gen_c_guards ?(count_calls = false) cond bound_ids
+    currently_defined_bv_sizes =
+  let counted call =
+    if count_calls then "DECODE_STATS_GUARD(" ^ call ^ ")" else call
+  in
   let gen_c_int_operand op =
     match op with
     | Ident name -> if List.mem name bound_ids then name else "ctx->" ^ name
     | Funcall (name, args) ->
-        if List.length args == 0 then name ^ "(ctx)"
-        else name ^ "(" ^ String.concat "," args ^ ", ctx)"
+        if List.length args == 0 then counted (name ^ "(ctx)")
+        else counted (name ^ "(" ^ String.concat "," args ^ ", ctx)")
     | Number n -> string_of_int n
   in
   match cond with
@@ -213,9 +367,8 @@ let rec gen_c_guards cond bound_ids currently_defined_bv_sizes =
               let e =
                 match valu.[0] with
                 | '0' ->
-                    let val_len = (String.length valu - 2) * 4 in
-                    len_consumed := !len_consumed + val_len;
-                    valu
+                    len_consumed := !len_consumed + sized_bitv_str_width valu;
+                    sized_bitv_str_to_c valu
                 | identifier ->
                     let val_len =
                       Hashtbl.find currently_defined_bv_sizes valu
@@ -245,21 +398,25 @@ let rec gen_c_guards cond bound_ids currently_defined_bv_sizes =
           args
       in
       let sep = if List.length args > 0 then "," else "" in
-      name ^ "(" ^ String.concat "," argnames ^ sep ^ "ctx" ^ ")"
+      counted (name ^ "(" ^ String.concat "," argnames ^ sep ^ "ctx" ^ ")")
   | And (g1, g2) ->
       "("
-      ^ gen_c_guards g1 bound_ids currently_defined_bv_sizes
+      ^ gen_c_guards ~count_calls g1 bound_ids currently_defined_bv_sizes
       ^ ") && ("
-      ^ gen_c_guards g2 bound_ids currently_defined_bv_sizes
+      ^ gen_c_guards ~count_calls g2 bound_ids currently_defined_bv_sizes
       ^ ")"
   | Or (g1, g2) ->
       "("
-      ^ gen_c_guards g1 bound_ids currently_defined_bv_sizes
+      ^ gen_c_guards ~count_calls g1 bound_ids currently_defined_bv_sizes
       ^ ") || ("
-      ^ gen_c_guards g2 bound_ids currently_defined_bv_sizes
+      ^ gen_c_guards ~count_calls g2 bound_ids currently_defined_bv_sizes
+      ^ ")"
+  | Not g ->
+      "!("
+      ^ gen_c_guards ~count_calls g bound_ids currently_defined_bv_sizes
       ^ ")"
-  | Not g -> "!(" ^ gen_c_guards g bound_ids currently_defined_bv_sizes ^ ")"
   | True -> ""
+  | False -> "0"
 
 let get_all_bound_identifiers conditions =
   let get_bound_id cond =
@@ -271,6 +428,24 @@ let get_all_bound_identifiers conditions =
   in
   List.filter_map get_bound_id conditions
 
+let rec guard_identifiers guard =
+  let int_operand_identifiers op =
+    match op with
+    | Ident name -> [name]
+    | Funcall (_, args) -> args
+    | Number _ -> []
+  in
+  match guard with
+  | Eq_int (op1, op2) | Less_eq_int (op1, op2) | Less_eq_or_eq (op1, op2) ->
+      int_operand_identifiers op1 @ int_operand_identifiers op2
+  | Eq_bit (bv, _, _) -> [bv]
+  | Eq_bv (left, right) -> right :: left
+  | Less_eq_bv (left, right) -> [left; right]
+  | Boolfun (_, args) -> args
+  | And (g1, g2) | Or (g1, g2) -> guard_identifiers g1 @ guard_identifiers g2
+  | Not g -> guard_identifiers g
+  | True | False -> []
+
 let rec nest mapbinds guards binds conseqs =
   match mapbinds with
   | [] -> (
@@ -281,56 +456,395 @@ let rec nest mapbinds guards binds conseqs =
     )
   | mb :: rest -> mb ^ nest rest guards binds conseqs ^ "}"
 
-let gen_c_rule state rule =
+(* By default a rule checks its conditions and then builds its ast node. When
+   it's already known to fire, [checks_conditions] skips its asserts and guards,
+   and [fired_c_stmts] replaces building the node with arbitrary statements,
+   which [only_guard_binds] tells don't need the fields that the guards don't :
+   those are not bound, and struct map-binds only check their slice.
+   [return_c_stmt] ends building the node, for procedures returning a value *)
+let gen_c_rule ?(checks_conditions = true) ?fired_c_stmts
+    ?(only_guard_binds = false) ?return_c_stmt state rule =
   Hashtbl.clear state.currently_defined_bv_sizes;
 
   let conditions, guards, consequences = rule in
   let conditions_with_offsets = annotate_conds_with_start_offsets conditions in
-  let assert_c_exprs = List.filter_map gen_c_assert conditions_with_offsets in
+  let asserts_c_expr =
+    if not checks_conditions then None
+    else if state.fuse_asserts then gen_c_fixed_bits_test rule
+    else (
+      match List.filter_map gen_c_assert conditions_with_offsets with
+      | [] -> None
+      | assert_c_exprs -> Some (String.concat "&&" assert_c_exprs)
+    )
+  in
+  let used_by_guards = guard_identifiers guards in
   let bind_c_stmts =
-    List.filter_map (gen_c_bind state) conditions_with_offsets
+    conditions_with_offsets
+    |> List.filter (fun (_, cond) ->
+           match cond with
+           | Bind (_, var) when only_guard_binds ->
+               List.mem var used_by_guards
+           | _ -> true
+       )
+    |> List.filter_map (gen_c_bind state)
+  in
+  let mapbind_c_stmts =
+    conditions_with_offsets
+    |> List.filter_map (fun (start_offset, cond) ->
+           let validity_only =
+             match cond with
+             | Struct_map_bind (_, _, _, var) when only_guard_binds ->
+                 not
+                   (List.exists
+                      (fun id -> id = var || str_starts_with (var ^ ".") id)
+                      used_by_guards
+                   )
+             | _ -> false
+           in
+           gen_c_mapbind ~validity_only state (start_offset, cond)
+       )
   in
-  let mapbind_c_stmts = List.filter_map gen_c_mapbind conditions_with_offsets in
   let bound_identifiers = get_all_bound_identifiers conditions in
   let guards_c_exprs =
-    gen_c_guards guards bound_identifiers state.currently_defined_bv_sizes
+    if checks_conditions then
+      gen_c_guards ~count_calls:state.decode_stats guards bound_identifiers
+        state.currently_defined_bv_sizes
+    else ""
+  in
+  let Assign_node_type rule_name, _ = consequences in
+  let return_c_stmt =
+    if state.decode_stats then
+      Some
+        ("DECODE_STATS_MATCH("
+        ^ add_prefix_unless_exists identifier_prefix rule_name
+        ^ ");"
+        ^ Option.value return_c_stmt ~default:"return;"
+        )
+    else return_c_stmt
+  in
+  let consequences_c_stmts =
+    match fired_c_stmts with
+    | Some stmts -> stmts
+    | None -> gen_c_consequences ?return_c_stmt state consequences
   in
-  let consequences_c_stmts = gen_c_consequences state consequences in
   let rule_c_code =
     nest mapbind_c_stmts guards_c_exprs bind_c_stmts consequences_c_stmts
   in
-  let Assign_node_type rule_name, _ = consequences in
   let rule_comment_start =
     "\n//----------------------------" ^ rule_name
     ^ "------------------------------//\n"
+    ^ if state.decode_stats then "DECODE_STATS_RULE();" else ""
   in
   let rule_comment_end =
     "\n\
      //------------------------------------------------------------------------------------//\n"
   in
-  match assert_c_exprs with
-  | [] -> rule_comment_start ^ "{" ^ rule_c_code ^ "}" ^ rule_comment_end
-  | _ ->
-      rule_comment_start ^ "if ("
-      ^ String.concat "&&" assert_c_exprs
-      ^ ") {" ^ rule_c_code ^ "}" ^ rule_comment_end
+  match asserts_c_expr with
+  | None -> rule_comment_start ^ "{" ^ rule_c_code ^ "}" ^ rule_comment_end
+  | Some asserts ->
+      rule_comment_start ^ "if (" ^ asserts ^ ") {" ^ rule_c_code ^ "}"
+      ^ rule_comment_end
 
 let gen_c_decoder state decoder =
-  String.concat "" (List.map (gen_c_rule state) decoder)
-
-let decoder_to_c ?(c_proc_name = "decode") decoder walker =
-  let defines =
-    "#define SLICE_BITVEC(v, s, e)"
-    ^ "((v >> s) & ((((uint64_t)1) << (e - s + 1)) - 1)) \n\n\n"
-    ^ "#define INDEX_BITVEC(v, i) ((v >> i) & 1) \n\n\n"
+  let gen_c_rule_of_state rule =
+    match state.insn_id_of_rule with
+    | Some insn_id ->
+        gen_c_rule ~only_guard_binds:true
+          ~fired_c_stmts:("return " ^ insn_id rule ^ ";")
+          state rule
+    | None -> gen_c_rule state rule
   in
+  String.concat "" (List.map gen_c_rule_of_state decoder)
+
+let rec gen_c_decode_tree state tree =
+  match tree with
+  | Leaf rules -> gen_c_decoder state rules
+  | Switch (start_offset, len, branches, default) ->
+      let end_offset = start_offset + len - 1 in
+      let switch_start =
+        "switch (SLICE_BITVEC(" ^ binary_stream_c_parameter ^ " , "
+        ^ string_of_int start_offset ^ " , " ^ string_of_int end_offset
+        ^ ")) { "
+      in
+      let c_cases =
+        List.map
+          (fun (key, subtree) ->
+            "case " ^ Printf.sprintf "0x%X" key ^ ": {"
+            ^ gen_c_decode_tree state subtree
+            ^ "break;} "
+          )
+          branches
+      in
+      let c_default =
+        match default with
+        | Some subtree ->
+            "default: {" ^ gen_c_decode_tree state subtree ^ "break;} "
+        | None -> ""
+      in
+      switch_start ^ String.concat "" c_cases ^ c_default ^ "}"
+
+let slice_macros =
+  "#define SLICE_BITVEC(v, s, e)"
+  ^ "((v >> s) & ((((uint64_t)1) << (e - s + 1)) - 1)) \n\n\n"
+  ^ "#define INDEX_BITVEC(v, i) ((v >> i) & 1) \n\n\n"
+
+(* With [decode_stats], the procedure counts the rules it tries and the guard
+   helpers it calls before building an ast node, and the inputs no rule
+   matches, through macros that RISCVDecodeStats.h defines to nothing unless
+   RISCV_DECODE_STATS is defined *)
+let decoder_to_c ?(c_proc_name = "decode") ?(as_tree = false)
+    ?(dense_mapbinds = false) ?(decode_stats = false) decoder walker =
+  let defines = slice_macros in
   let procedure_start =
     "static void " ^ c_proc_name ^ "(struct " ^ ast_sail_def_name ^ " *"
     ^ ast_c_parameter ^ ", uint64_t " ^ binary_stream_c_parameter
     ^ ", RVContext *ctx)"
   in
   let initial_state =
-    { typedef_walker = walker; currently_defined_bv_sizes = Hashtbl.create 100 }
+    mk_state ~fuse_asserts:as_tree ~dense_mapbinds
+      ~dense_table_prefix:c_proc_name ~decode_stats walker
+  in
+  let procedure_body =
+    if as_tree then gen_c_decode_tree initial_state (gen_decode_tree decoder)
+    else gen_c_decoder initial_state decoder
+  in
+  let stats_begin, stats_end =
+    if decode_stats then
+      ("DECODE_STATS_BEGIN(" ^ c_proc_name ^ ");", "DECODE_STATS_NO_MATCH();")
+    else ("", "")
+  in
+  defines
+  ^ Buffer.contents initial_state.dense_tables_c_code
+  ^ procedure_start ^ "{" ^ stats_begin ^ procedure_body ^ stats_end ^ "}"
+
+(* A decoder whose rules only test the low [index_bits] bits of the input can be
+   memoized into a table holding, for every value of those bits, the index of
+   the first rule to fire on it. Looking the index up then leaves only the
+   fields of that one rule to extract. Guards are folded into the table too,
+   so it's only valid for the context it was built with *)
+let no_rule_index = 0xFF
+
+let check_decoder_is_tabulable c_proc_name index_bits decoder =
+  let fail why =
+    failwith ("Can't generate a lookup table for " ^ c_proc_name ^ ": " ^ why)
+  in
+  if List.length decoder >= no_rule_index then fail "too many rules";
+  List.iter
+    (fun (conditions, guard, (Assign_node_type case, _)) ->
+      List.iter
+        (fun (start_offset, cond) ->
+          match cond with
+          | _ when start_offset + condition_length cond <= index_bits -> ()
+          (* A bind past the index bits is fine as long as it only feeds the
+             ast node, e.g. C_ILLEGAL which keeps the whole input *)
+          | Bind _ when guard = True -> ()
+          | _ ->
+              fail
+                ("rule " ^ case ^ " tests bits past the first "
+               ^ string_of_int index_bits
+                )
+        )
+        (annotate_conds_with_start_offsets conditions)
+    )
+    decoder
+
+(* With [decode_stats], every lookup is counted by _apply() in the counters of
+   [c_proc_name] : as a single rule tried, the one the table holds, and no
+   guard calls since those were made while building the table *)
+let decoder_table_to_c ?(c_proc_name = "decode") ?(dense_mapbinds = false)
+    ?(decode_stats = false) ~index_bits decoder walker =
+  check_decoder_is_tabulable c_proc_name index_bits decoder;
+  let macro_prefix = String.uppercase_ascii c_proc_name in
+  let no_rule = macro_prefix ^ "_NO_RULE" in
+  let table_size = macro_prefix ^ "_TABLE_SIZE" in
+  let state =
+    mk_state ~dense_mapbinds ~dense_table_prefix:(c_proc_name ^ "_table") walker
+  in
+  (* Shares the dense tables of state, only _apply() is instrumented *)
+  let apply_state = { state with decode_stats } in
+  let stats_begin, stats_no_match =
+    if decode_stats then
+      ( "DECODE_STATS_BEGIN(" ^ c_proc_name ^ ");",
+        "default: DECODE_STATS_NO_MATCH();"
+      )
+    else ("", "")
+  in
+  let defines =
+    "#define " ^ no_rule ^ " " ^ string_of_int no_rule_index ^ "\n\n"
+    ^ "#define " ^ table_size ^ " (1 << " ^ string_of_int index_bits ^ ")\n\n"
+  in
+  let match_proc =
+    "static uint8_t " ^ c_proc_name ^ "_match(uint64_t "
+    ^ binary_stream_c_parameter ^ ", RVContext *ctx) {"
+    ^ String.concat ""
+        (List.mapi
+           (fun i rule ->
+             let fired_c_stmts = "return " ^ string_of_int i ^ ";" in
+             gen_c_rule ~only_guard_binds:true ~fired_c_stmts state rule
+           )
+           decoder
+        )
+    ^ "return " ^ no_rule ^ ";}"
+  in
+  let apply_proc =
+    "static void " ^ c_proc_name ^ "_apply(struct " ^ ast_sail_def_name ^ " *"
+    ^ ast_c_parameter ^ ", uint64_t " ^ binary_stream_c_parameter
+    ^ ", uint8_t rule, RVContext *ctx) {" ^ stats_begin ^ "switch (rule) {"
+    ^ String.concat ""
+        (List.mapi
+           (fun i rule ->
+             "case " ^ string_of_int i ^ ": "
+             ^ gen_c_rule ~checks_conditions:false apply_state rule
+             ^ "break;"
+           )
+           decoder
+        )
+    ^ stats_no_match ^ "}}"
+  in
+  let build_table_proc =
+    "static void " ^ c_proc_name
+    ^ "_build_table(uint8_t *table, RVContext *ctx) {"
+    ^ "for (uint64_t i = 0; i < " ^ table_size ^ "; i++) {"
+    ^ "table[i] = " ^ c_proc_name ^ "_match(i, ctx);}}"
+  in
+  let lookup_proc =
+    "static void " ^ c_proc_name ^ "_from_table(struct " ^ ast_sail_def_name
+    ^ " *" ^ ast_c_parameter ^ ", uint64_t " ^ binary_stream_c_parameter
+    ^ ", const uint8_t *table, RVContext *ctx) {" ^ c_proc_name ^ "_apply("
+    ^ ast_c_parameter ^ ", " ^ binary_stream_c_parameter ^ ", table["
+    ^ binary_stream_c_parameter ^ " & (" ^ table_size ^ " - 1)], ctx);}"
+  in
+  defines
+  ^ Buffer.contents state.dense_tables_c_code
+  ^ match_proc ^ apply_proc ^ build_table_proc ^ lookup_proc
+
+(* Decoders that only tell which instruction an input is, for the callers that
+   don't need its fields : the rules check their conditions exactly like in the
+   full decoder but then return the RISCV_INSN_* value that get_insn_type()
+   would give for the ast node they build. That value is to_insn[case][0], or
+   to_insn[case][op] for the ast cases whose instruction type depends on an
+   enum member op, which the rule either pushes as a constant or looks up
+   through a map-bind *)
+let decode_id_no_match = "DECODE_ID_NO_MATCH"
+
+let insn_id_of_rule instr_types (_, _, (Assign_node_type case, items)) =
+  let case = strip_prefix_if_exists identifier_prefix case in
+  let enum_member_index =
+    match Hashtbl.find_opt instr_types case with
+    | Some (Types (i, _)) -> i
+    | Some (Same_as other_case) -> (
+        match Hashtbl.find instr_types other_case with
+        | Types (i, _) -> i
+        | Same_as _ -> failwith "UNREACHABLE"
+      )
+    | None -> failwith ("No instruction type for ast case " ^ case)
+  in
+  let index_c_expr =
+    if enum_member_index = -1 then "0"
+    else (
+      match List.nth items enum_member_index with
+      | Push v -> c_value_of_value v
+      | Concat_push _ ->
+          failwith ("Can't index instruction types by a concat in " ^ case)
+    )
+  in
+  "to_insn["
+  ^ add_prefix_unless_exists identifier_prefix case
+  ^ "][" ^ index_c_expr ^ "]"
+
+let decoder_id_to_c ?(c_proc_name = "decode") ?(as_tree = false)
+    ?(dense_mapbinds = false) decoder walker instr_types =
+  let state =
+    mk_state ~fuse_asserts:as_tree ~dense_mapbinds
+      ~dense_table_prefix:(c_proc_name ^ "_insn_id")
+      ~insn_id_of_rule:(insn_id_of_rule instr_types)
+      walker
+  in
+  let procedure_body =
+    if as_tree then gen_c_decode_tree state (gen_decode_tree decoder)
+    else gen_c_decoder state decoder
+  in
+  Buffer.contents state.dense_tables_c_code
+  ^ "static uint16_t " ^ c_proc_name ^ "_insn_id(uint64_t "
+  ^ binary_stream_c_parameter ^ ", RVContext *ctx) {" ^ procedure_body
+  ^ "return " ^ decode_id_no_match ^ ";}"
+
+(* The entry point dispatching on the length of the instruction in the low
+   bits of word, like the callers of decode() and decode_compressed() do *)
+let decode_id_to_c ~decoder_id_c ~compressed_decoder_id_c =
+  slice_macros ^ "#define " ^ decode_id_no_match ^ " 0xFFFF\n\n"
+  ^ decoder_id_c ^ compressed_decoder_id_c
+  ^ "static uint16_t decode_id(uint32_t word, RVContext *ctx, uint8_t *len) {"
+  ^ "if ((word & 0x3) != 0x3) { *len = 2;"
+  ^ "return decode_compressed_insn_id(word & 0xFFFF, ctx);}"
+  ^ "*len = 4; return decode_insn_id(word, ctx);}"
+
+(* See Control_flow. Returns 1 after building the ast node of a control-flow
+   instruction, and 0 for any other input *)
+let control_flow_decoder_to_c ?(c_proc_name = "decode") control_flow_rules
+    walker =
+  let state = mk_state walker in
+  let slices = Control_flow.filter_key_slices control_flow_rules in
+  let keys = Control_flow.filter_keys slices control_flow_rules in
+  let key_bits = List.fold_left (fun bits (_, len) -> bits + len) 0 slices in
+  let filter_name = c_proc_name ^ "_control_flow_filter" in
+  let filter_table =
+    "static const uint8_t " ^ filter_name ^ "["
+    ^ string_of_int (1 lsl key_bits)
+    ^ "] = {"
+    ^ String.concat ","
+        (List.init (1 lsl key_bits) (fun key ->
+             if List.mem key keys then "1" else "0"
+         )
+        )
+    ^ "};"
+  in
+  let key_c_expr =
+    let key_len = ref 0 in
+    let parts =
+      List.map
+        (fun (start, len) ->
+          let part =
+            "(SLICE_BITVEC(" ^ binary_stream_c_parameter ^ " , "
+            ^ string_of_int start ^ " , "
+            ^ string_of_int (start + len - 1)
+            ^ ") << " ^ string_of_int !key_len ^ ")"
+          in
+          key_len := !key_len + len;
+          part
+        )
+        slices
+    in
+    match parts with [] -> "0" | _ -> String.concat "|" parts
+  in
+  let rules_c_code =
+    List.map
+      (fun (rule, is_control_flow) ->
+        if is_control_flow then gen_c_rule ~return_c_stmt:"return 1;" state rule
+        else
+          gen_c_rule ~only_guard_binds:true ~fired_c_stmts:"return 0;" state
+            rule
+      )
+      control_flow_rules
+  in
+  filter_table ^ "static uint8_t " ^ c_proc_name ^ "_control_flow(struct "
+  ^ ast_sail_def_name ^ " *" ^ ast_c_parameter ^ ", uint64_t "
+  ^ binary_stream_c_parameter ^ ", RVContext *ctx) {" ^ "if (!" ^ filter_name
+  ^ "[" ^ key_c_expr ^ "]) { return 0; }"
+  ^ String.concat "" rules_c_code
+  ^ "return 0;}"
+
+(* Whether the ast node was built by a control-flow rule, for the callers
+   checking the control-flow decoders against the full ones *)
+let control_flow_cases_to_c cases =
+  let case_labels =
+    List.map
+      (fun case ->
+        "case " ^ add_prefix_unless_exists identifier_prefix case ^ ":"
+      )
+      (List.sort compare (List.of_seq (Hashtbl.to_seq_keys cases)))
   in
-  let procedure_body = gen_c_decoder initial_state decoder in
-  defines ^ procedure_start ^ "{" ^ procedure_body ^ "}"
+  "static inline uint8_t is_control_flow_case(const struct " ^ ast_sail_def_name
+  ^ " *" ^ ast_c_parameter ^ ") {" ^ "switch (" ^ ast_c_parameter
+  ^ "->ast_node_type) {" ^ String.concat "" case_labels
+  ^ "return 1; default: return 0;}}"
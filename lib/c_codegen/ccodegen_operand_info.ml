@@ -7,18 +7,19 @@ open Utils
 open Gen_clike_typedef
 open Gen_operand_info_defs
 
+let regfile_index_typecaster regfile =
+  match regfile with
+  | Base -> "AS_GEN_PURPOSE_REG"
+  | Float_or_Double -> "AS_FLOAT_REG"
+  (* assume the compressed register is a general purpose register, true for most cases *)
+  (* float cases will be patched manually later *)
+  | Base_or_Float -> "AS_COMPRESSED_GEN_PURPOSE_REG"
+  | Vector -> "AS_VECTOR_REG"
+
 let single_operand_to_c index operand walker =
   match operand with
   | Left (Reg (idx, regfile, regacess)) ->
-      let regfile_index_typecaster =
-        match regfile with
-        | Base -> "AS_GEN_PURPOSE_REG"
-        | Float_or_Double -> "AS_FLOAT_REG"
-        (* assume the compressed register is a general purpose register, true for most cases *)
-        (* float cases will be patched manually later *)
-        | Base_or_Float -> "AS_COMPRESSED_GEN_PURPOSE_REG"
-        | Vector -> "AS_VECTOR_REG"
-      in
+      let regfile_index_typecaster = regfile_index_typecaster regfile in
       let op_indexing = "ops[" ^ string_of_int index ^ "]" in
       op_indexing ^ ".type = RISCV_OP_REG;" ^ op_indexing ^ ".reg = "
       ^ regfile_index_typecaster ^ "(" ^ ast_c_parameter ^ "->"
@@ -29,7 +30,7 @@ let single_operand_to_c index operand walker =
           else "CS_AC_READ | CS_AC_WRITE"
         )
       ^ ";"
-  | Right (Imm idx) ->
+  | Right (Imm (idx, _)) ->
       let op_indexing = "ops[" ^ string_of_int index ^ "]" in
       op_indexing ^ ".type = RISCV_OP_IMM;" ^ op_indexing ^ " .imm = "
       ^ ast_c_parameter ^ "->"
@@ -39,9 +40,9 @@ let single_operand_to_c index operand walker =
 let operand_lists_to_c reg_ops imm_ops walker =
   let compare_ops op1 op2 =
     match (op1, op2) with
-    | Left (Reg (i1, _, _)), Right (Imm i2)
-    | Right (Imm i1), Left (Reg (i2, _, _))
-    | Right (Imm i1), Right (Imm i2)
+    | Left (Reg (i1, _, _)), Right (Imm (i2, _))
+    | Right (Imm (i1, _)), Left (Reg (i2, _, _))
+    | Right (Imm (i1, _)), Right (Imm (i2, _))
     | Left (Reg (i1, _, _)), Left (Reg (i2, _, _)) ->
         Int.compare i1 i2
   in
@@ -86,3 +87,111 @@ let operand_info_to_c op_info walker =
     )
     op_info.registers_info;
   procedure_start ^ String.concat "" !cases ^ " }}"
+
+(* For columnar consumers, every register operand is also given one of 4 fixed
+   roles : the destination, written by the instruction, and up to 3 sources, in
+   the order of their names (rs1, rs2, rs3, vs1, vs2, ...). A register that is
+   both read and written (e.g. rsd) is the destination and the first source.
+   The immediate is the first immediate operand, with the value the assembly
+   shows : scaled by the bits appended to it and sign-extended to 64 bits when
+   signed. Registers are numbered like in fill_operands, before patch_operands
+   fixes them up *)
+let num_register_roles = 4
+
+let member_name path =
+  match String.rindex_opt path '.' with
+  | Some i -> String.sub path (i + 1) (String.length path - i - 1)
+  | None -> path
+
+let case_operand_roles_to_c name reg_ops imm_ops walker =
+  set_walker_case walker name;
+  let reg_c_expr (Reg (idx, regfile, _)) =
+    regfile_index_typecaster regfile
+    ^ "(" ^ ast_c_parameter ^ "->"
+    ^ Option.get (get_member_path walker idx)
+    ^ ")"
+  in
+  let reg_name (Reg (idx, _, _)) =
+    member_name (Option.get (get_member_path walker idx))
+  in
+  let by_index = List.sort compare reg_ops in
+  let destination =
+    List.find_opt (fun (Reg (_, _, access)) -> access <> Read) by_index
+  in
+  let sources =
+    List.filter (fun (Reg (_, _, access)) -> access <> Write) by_index
+    |> List.stable_sort (fun (Reg (_, _, a1) as r1) (Reg (_, _, a2) as r2) ->
+           compare
+             (a1 <> Read_and_Write, reg_name r1)
+             (a2 <> Read_and_Write, reg_name r2)
+       )
+  in
+  let roles =
+    Option.to_list (Option.map (fun r -> (0, r)) destination)
+    @ List.filteri
+        (fun i _ -> i < num_register_roles - 1)
+        (List.mapi (fun i r -> (i + 1, r)) sources)
+  in
+  let imm_statements =
+    match List.sort compare imm_ops with
+    | Imm (idx, { bits; is_signed; shift; low_bits }) :: _ ->
+        let value =
+          "(uint64_t)" ^ ast_c_parameter ^ "->"
+          ^ Option.get (get_member_path walker idx)
+        in
+        let value =
+          if shift = 0 then value
+          else
+            "(" ^ value ^ " << " ^ string_of_int shift ^ " | "
+            ^ string_of_int low_bits ^ ")"
+        in
+        let value =
+          if is_signed then (
+            let sign = "(1ULL << " ^ string_of_int (bits - 1) ^ ")" in
+            "(" ^ value ^ " ^ " ^ sign ^ ") - " ^ sign
+          )
+          else value
+        in
+        ["*imm = " ^ value ^ ";"]
+    | [] -> []
+  in
+  let statements =
+    List.map
+      (fun (role, r) ->
+        "regs[" ^ string_of_int role ^ "] = " ^ reg_c_expr r ^ ";"
+      )
+      roles
+    @ imm_statements
+  in
+  "case "
+  ^ add_prefix_unless_exists identifier_prefix name
+  ^ ": {" ^ String.concat "" statements ^ "break;}"
+
+let operand_roles_to_c op_info walker =
+  let procedure_start =
+    "\n/* fill_operand_roles() writes this many registers */\n#define \
+     RISCV_OPERAND_ROLES "
+    ^ string_of_int num_register_roles
+    ^ "\n" ^ "static inline void fill_operand_roles(struct "
+    ^ ast_sail_def_name ^ " *" ^ ast_c_parameter
+    ^ ", uint8_t *regs, uint64_t *imm) {"
+    ^ "memset(regs, 0, " ^ string_of_int num_register_roles ^ ");"
+    ^ "*imm = 0;" ^ "switch (" ^ ast_c_parameter ^ "->" ^ ast_sail_def_name
+    ^ generated_ast_enum_suffix ^ ") {"
+  in
+  let operands_of tbl case_name =
+    Option.value ~default:[] (Hashtbl.find_opt tbl case_name)
+  in
+  let cases =
+    List.sort_uniq compare
+      (List.of_seq (Hashtbl.to_seq_keys op_info.registers_info)
+      @ List.of_seq (Hashtbl.to_seq_keys op_info.immediates_info)
+      )
+    |> List.map (fun case_name ->
+           case_operand_roles_to_c case_name
+             (operands_of op_info.registers_info case_name)
+             (operands_of op_info.immediates_info case_name)
+             walker
+       )
+  in
+  procedure_start ^ String.concat "" cases ^ "default: break;}}"
@@ -0,0 +1,97 @@
+open Capstone_autosync_sail
+
+open Clike_typedef
+open Packed_ast
+open Constants
+
+open Ccodegen_clike_typedef
+
+let packed_c_type = "packed_" ^ ast_sail_def_name
+
+(* In 64 bits, a native int has too few bits for the widest masks *)
+let mask_of_width width =
+  if width >= 64 then "~0ULL"
+  else Printf.sprintf "0x%LXULL" (Int64.pred (Int64.shift_left 1L width))
+
+let leaf_c_type leaf =
+  match leaf with
+  | Clike_builtin (_, builtin) -> clike_builtin_c_type builtin
+  | Clike_enum ("", _, _) -> "uint32_t"
+  | Clike_enum (typname, _, _) -> "enum " ^ typname
+  | Clike_typename (typname, _) -> typname
+  | _ -> failwith "Expected a leaf type"
+
+let field_c_path field =
+  ast_c_parameter ^ "->" ^ ast_sail_def_name ^ generated_ast_payload_suffix
+  ^ "." ^ field.path
+
+let field_c_value field =
+  "((packed >> " ^ string_of_int field.offset ^ ") & "
+  ^ mask_of_width field.width ^ ")"
+
+let cases_to_c layout field_to_c =
+  String.concat ""
+    (List.filter_map
+       (fun case ->
+         if case.fields = [] then None
+         else
+           Some
+             ("case " ^ case.case_name ^ ":"
+             ^ String.concat "" (List.map field_to_c case.fields)
+             ^ "break;"
+             )
+       )
+       layout.cases
+    )
+
+let pack_to_c layout =
+  "static inline " ^ packed_c_type ^ " pack_" ^ ast_sail_def_name
+  ^ "(const struct " ^ ast_sail_def_name ^ " *" ^ ast_c_parameter ^ ") {"
+  ^ packed_c_type ^ " packed = " ^ ast_c_parameter ^ "->" ^ ast_sail_def_name
+  ^ generated_ast_enum_suffix ^ ";" ^ "switch (" ^ ast_c_parameter ^ "->"
+  ^ ast_sail_def_name ^ generated_ast_enum_suffix ^ ") {"
+  ^ cases_to_c layout (fun field ->
+        "packed |= ((" ^ packed_c_type ^ ")" ^ field_c_path field ^ " & "
+        ^ mask_of_width field.width ^ ") << " ^ string_of_int field.offset ^ ";"
+    )
+  ^ "default: break;}" ^ "return packed;}"
+
+let unpack_to_c layout =
+  "static inline void unpack_" ^ ast_sail_def_name ^ "(" ^ packed_c_type
+  ^ " packed, struct " ^ ast_sail_def_name ^ " *" ^ ast_c_parameter ^ ") {"
+  ^ ast_c_parameter ^ "->" ^ ast_sail_def_name ^ generated_ast_enum_suffix
+  ^ " = packed & " ^ mask_of_width layout.case_bits ^ ";" ^ "switch ("
+  ^ ast_c_parameter ^ "->" ^ ast_sail_def_name ^ generated_ast_enum_suffix
+  ^ ") {"
+  ^ cases_to_c layout (fun field ->
+        field_c_path field ^ " = " ^ field_c_value field ^ ";"
+    )
+  ^ "default: break;}}"
+
+(* packed_<case>_<member>() reads a single member, without unpacking the rest
+   of the case. It doesn't check that the packed ast is of that case *)
+let getters_to_c layout =
+  String.concat ""
+    (List.concat_map
+       (fun case ->
+         List.map
+           (fun field ->
+             let name =
+               String.map (fun c -> if c = '.' then '_' else c) field.path
+             in
+             "static inline " ^ leaf_c_type field.leaf ^ " packed_" ^ name ^ "("
+             ^ packed_c_type ^ " packed) { return " ^ field_c_value field
+             ^ ";}"
+           )
+           case.fields
+       )
+       layout.cases
+    )
+
+let packed_ast_to_c layout =
+  "#define PACKED_AST_CASE_BITS "
+  ^ string_of_int layout.case_bits
+  ^ "\n\n" ^ "typedef uint64_t " ^ packed_c_type ^ ";"
+  ^ "static inline uint16_t " ^ packed_c_type ^ "_case(" ^ packed_c_type
+  ^ " packed) { return packed & " ^ mask_of_width layout.case_bits ^ ";}"
+  ^ pack_to_c layout ^ unpack_to_c layout ^ getters_to_c layout
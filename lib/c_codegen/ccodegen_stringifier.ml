@@ -10,16 +10,145 @@ open Hashset
 type assembler_stringification_state = {
   walker : typedef_walker;
   already_defined_tables : string set;
+  (* Whether literals are appended with ss_append_lit() of
+     RISCVAst2StrHelpers.h, which knows their length, instead of
+     SStream_concat() *)
+  literal_appends : bool;
+  (* Whether the tables mapping enums and bitvectors to strings are emitted as
+     arrays of offsets into a single pool of strings, see pooled_tbl_to_c *)
+  mnemonic_tables : bool;
+  pool : Buffer.t;
+  pool_offsets : (string, int) Hashtbl.t;
+  pool_size : int ref;
+  (* The arrays of the pooled tables, which go along with the pool and the
+     templates into a file without SStream, see pool_file_to_c *)
+  pooled_tables : Buffer.t;
+  (* Whether the subcases are lowered into format templates rendered by
+     RISCVAst2StrTemplates.h, see template_of_body. Identical templates are
+     emitted once *)
+  format_templates : bool;
+  templates : Buffer.t;
+  template_offsets : (string, int) Hashtbl.t;
+  templates_size : int ref;
+  (* The index of each table the templates use, and the initializers of their
+     RVTemplateTable in reverse order *)
+  template_tables : (string, int) Hashtbl.t;
+  template_table_entries : string list ref;
+  (* Whether ast2str_buf() is generated too, see ast2str_buf_to_c. Every
+     subcase must then be lowered into a template, its cases fill buf_cases *)
+  ast2str_buf : bool;
+  buf_cases : Buffer.t;
+  templates_max_bound : int ref;
+  templates_max_args : int ref;
 }
 
-let tostr_tbl_to_c { walker; already_defined_tables } name idx arg_idx tbl =
+let pool_name = "ast2str_string_pool"
+
+(* The length of the C string literal contents lit, which only contains
+   single-character escapes *)
+let c_literal_length lit =
+  let rec count i len =
+    if i >= String.length lit then len
+    else if lit.[i] = '\\' then (
+      match lit.[i + 1] with
+      | '0' .. '9' | 'x' | 'u' | 'U' ->
+          failwith ("Can't pool the string " ^ lit ^ ", it has a long escape")
+      | _ -> count (i + 2) (len + 1)
+    )
+    else count (i + 1) (len + 1)
+  in
+  count 0 0
+
+(* Returns the offset of lit in the pool, adding it if it isn't there yet *)
+let pool_offset { pool; pool_offsets; pool_size; _ } lit =
+  match Hashtbl.find_opt pool_offsets lit with
+  | Some offset -> offset
+  | None ->
+      let offset = !pool_size in
+      Hashtbl.add pool_offsets lit offset;
+      Buffer.add_string pool ("\"" ^ lit ^ "\" ");
+      pool_size := offset + c_literal_length lit;
+      offset
+
+let pool_to_c { pool; pool_size; _ } =
+  if !pool_size = 0 then ""
+  else (
+    if !pool_size > 0xFFFF then
+      failwith "The string pool of ast2str is too large for 16-bit offsets";
+    "static const char " ^ pool_name ^ "[] = " ^ Buffer.contents pool ^ ";"
+  )
+
+let concat_lit_to_c { literal_appends; _ } lit =
+  if not literal_appends then "SStream_concat(ss, \"" ^ lit ^ "\");"
+  else if lit = "" then ""
+  else "ss_append_lit(ss, \"" ^ lit ^ "\");"
+
+(* The bindings of a table sorted by key, bitvector values by their number and
+   enum constants by their name, so that the generated code doesn't depend on
+   the order of the hashtable *)
+let tbl_bindings_by_key tbl =
+  let key_order k =
+    match int_of_string_opt k with
+    | Some n -> (0, n, "")
+    | None -> (1, 0, k)
+  in
+  List.sort
+    (fun (a, _) (b, _) -> compare (key_order a) (key_order b))
+    (List.of_seq (Hashtbl.to_seq tbl))
+
+(* A table as two arrays indexed by the enum or bitvector value, the offset of
+   its string in the pool and its length, which values missing from the table
+   leave at 0. The arrays go into pooled_tables, the function appending the
+   string of a value is returned *)
+let pooled_tbl_to_c str_state name tbl =
+  let entries =
+    List.map
+      (fun (k, v) ->
+        let index =
+          if k.[0] = '0' then string_of_int (int_of_string k)
+          else add_prefix_unless_exists identifier_prefix k
+        in
+        if c_literal_length v > 0xFF then
+          failwith ("The string " ^ v ^ " is too long for " ^ name);
+        (index, pool_offset str_state v, c_literal_length v)
+      )
+      (tbl_bindings_by_key tbl)
+  in
+  let array_to_c elem_type suffix value =
+    "static const " ^ elem_type ^ " " ^ name ^ suffix ^ "[] = {"
+    ^ String.concat ","
+        (List.map
+           (fun entry ->
+             let index, _, _ = entry in
+             "[" ^ index ^ "] = " ^ string_of_int (value entry)
+           )
+           entries
+        )
+    ^ "};"
+  in
+  Buffer.add_string str_state.pooled_tables
+    (array_to_c "uint16_t" "_offsets" (fun (_, offset, _) -> offset)
+    ^ array_to_c "uint8_t" "_lengths" (fun (_, _, len) -> len)
+    );
+  "static inline void " ^ name ^ "(uint64_t member, SStream *ss) {"
+  ^ "if (member < sizeof(" ^ name ^ "_lengths)) {" ^ "ss_append(ss, "
+  ^ pool_name ^ " + " ^ name ^ "_offsets[member], " ^ name
+  ^ "_lengths[member]);}}"
+
+let tostr_tbl_to_c ({ walker; already_defined_tables; _ } as str_state) name
+    idx arg_idx tbl =
   let tbl_call =
     name ^ "(" ^ ast_c_parameter ^ "->"
     ^ Option.get (get_member_path walker arg_idx)
     ^ ", ss);"
   in
   let tbl_def =
-    if not (set_contains already_defined_tables name) then (
+    if set_contains already_defined_tables name then ""
+    else if str_state.mnemonic_tables then (
+      set_add already_defined_tables name;
+      pooled_tbl_to_c str_state name tbl
+    )
+    else (
       let proc_start = "void " ^ name ^ "(uint64_t member, SStream *ss) {" in
       let cases = ref [] in
       Hashtbl.iter
@@ -29,7 +158,7 @@ let tostr_tbl_to_c { walker; already_defined_tables } name idx arg_idx tbl =
             ^ ( if k.[0] = '0' then k
                 else add_prefix_unless_exists identifier_prefix k
               )
-            ^ ":{" ^ "SStream_concat(ss, \"" ^ v ^ "\"); break; }"
+            ^ ":{" ^ concat_lit_to_c str_state v ^ " break; }"
           in
           cases := case :: !cases
         )
@@ -37,10 +166,84 @@ let tostr_tbl_to_c { walker; already_defined_tables } name idx arg_idx tbl =
       set_add already_defined_tables name;
       proc_start ^ "switch (member) { " ^ String.concat "" !cases ^ "}}"
     )
-    else ""
   in
   (tbl_call, tbl_def)
 
+let templates_name = "ast2str_templates"
+
+let template_tables_name = "ast2str_template_tables"
+
+(* RV_TPL_SLOT_MAX and RV_TPL_MAX_BOUND of RISCVAst2StrTemplates.h *)
+let template_slot_max = 24
+
+let template_max_bound = 256
+
+(* The operation and operands of the slot of an intrinsic taking a single
+   argument, and the most characters it writes. None if the renderer doesn't
+   know the intrinsic *)
+let intrinsic_template_op name =
+  let width prefix =
+    let len = String.length prefix in
+    if String.length name > len && String.sub name 0 len = prefix then
+      int_of_string_opt (String.sub name len (String.length name - len))
+    else None
+  in
+  let fixed op = Some ([op], template_slot_max) in
+  match name with
+  | "reg_name" -> fixed "RV_TPL_REG"
+  | "creg_name" -> fixed "RV_TPL_CREG"
+  | "freg_name" -> fixed "RV_TPL_FREG"
+  | "vreg_name" -> fixed "RV_TPL_VREG"
+  | "freg_or_reg_name" -> fixed "RV_TPL_FREG_OR_REG"
+  | "fence_bits" -> fixed "RV_TPL_FENCE"
+  | "csr_name_map" -> fixed "RV_TPL_CSR"
+  | "maybe_vmask" -> fixed "RV_TPL_VMASK"
+  | "maybe_lmul_flag" -> fixed "RV_TPL_LMUL"
+  | "ta_flag" -> fixed "RV_TPL_TA"
+  | "ma_flag" -> fixed "RV_TPL_MA"
+  | _ -> (
+      match
+        (width "hex_bits_signed_", width "hex_bits_", width "dec_bits_")
+      with
+      | Some n, _, _ when n >= 1 && n <= 64 ->
+          Some (["RV_TPL_HEX_SIGNED"; string_of_int n], template_slot_max)
+      | _, Some n, _ when n >= 1 && n <= 64 ->
+          Some (["RV_TPL_HEX"; string_of_int n], template_slot_max)
+      (* bin_digits_to() writes whole bytes of digits *)
+      | _, _, Some n when n >= 1 && n <= 64 ->
+          Some (["RV_TPL_BIN"; string_of_int n], (n + 7) / 8 * 8)
+      | _ -> None
+    )
+
+let template_part_supported tostr =
+  match tostr with
+  | Lit _ | Bitv2Str _ | Enum2Str _ | Bool2Str _ | Struct2str _ -> true
+  | Intrinsic_tostr_logic (name, [_]) ->
+      Option.is_some (intrinsic_template_op name)
+  | Intrinsic_tostr_logic _ -> false
+
+(* The offset of lit in the pool on 2 bytes little-endian, then its length *)
+let pooled_literal_bytes str_state lit =
+  let offset = if lit = "" then 0 else pool_offset str_state lit in
+  let len = c_literal_length lit in
+  if len > 0xFF then
+    failwith ("The string " ^ lit ^ " is too long for a template");
+  List.map string_of_int [offset land 0xFF; offset lsr 8; len]
+
+let template_table_index { template_tables; template_table_entries; _ } name =
+  match Hashtbl.find_opt template_tables name with
+  | Some index -> index
+  | None ->
+      let index = Hashtbl.length template_tables in
+      if index > 0xFF then failwith "Too many tables for the format templates";
+      Hashtbl.add template_tables name index;
+      template_table_entries :=
+        ("{" ^ name ^ "_offsets, " ^ name ^ "_lengths, sizeof(" ^ name
+       ^ "_lengths)}"
+        )
+        :: !template_table_entries;
+      index
+
 let intrinsic_logic_arg_to_c walker arg =
   match arg with
   | Arg_index idx -> "tree->" ^ Option.get (get_member_path walker idx)
@@ -76,19 +279,47 @@ let intrinsic_logic_arg_to_c walker arg =
       in
       String.concat " | " shifted_args
 
+(* The condition of a Struct2str string, that the members of struct_arg have
+   the values of kv_pairs *)
+let struct_cond_to_c struct_arg kv_pairs =
+  let cond =
+    List.map
+      (fun (key, valu) ->
+        "(" ^ struct_arg ^ "." ^ key ^ " == "
+        ^ ( match valu with
+          | Bv_const s -> s
+          | Bool_const b -> if b then "1" else "0"
+          | Binding s -> s
+          | Enum_lit e -> add_prefix_unless_exists identifier_prefix e
+          )
+        ^ ")"
+      )
+      kv_pairs
+  in
+  String.concat " && " cond
+
 let tostr_logic_to_c ({ walker; _ } as str_state) i tostr =
   match tostr with
-  | Lit s -> ("SStream_concat(ss, \"" ^ s ^ "\");", "")
+  | Lit s -> (concat_lit_to_c str_state s, "")
   | Bitv2Str (name, arg_idx, tbl) -> tostr_tbl_to_c str_state name i arg_idx tbl
   | Enum2Str (name, arg_idx, tbl) -> tostr_tbl_to_c str_state name i arg_idx tbl
-  | Bool2Str (_, arg_idx, (false_case, true_case)) ->
-      let true_conc = "SStream_concat(ss, \"" ^ true_case ^ "\");" in
-      let false_conc = "SStream_concat(ss, \"" ^ false_case ^ "\");" in
-      ( "if (" ^ ast_c_parameter ^ "->"
-        ^ Option.get (get_member_path walker arg_idx)
-        ^ ") {" ^ true_conc ^ "}" ^ "else {" ^ false_conc ^ "} ",
-        ""
-      )
+  | Bool2Str (_, arg_idx, (false_case, true_case)) -> (
+      let true_conc = concat_lit_to_c str_state true_case in
+      let false_conc = concat_lit_to_c str_state false_case in
+      let member =
+        ast_c_parameter ^ "->" ^ Option.get (get_member_path walker arg_idx)
+      in
+      match (true_conc, false_conc) with
+      (* Only with literal_appends, which drops the appends of empty strings *)
+      | "", "" -> ("", "")
+      | _, "" -> ("if (" ^ member ^ ") {" ^ true_conc ^ "} ", "")
+      | "", _ -> ("if (!" ^ member ^ ") {" ^ false_conc ^ "} ", "")
+      | _ ->
+          ( "if (" ^ member ^ ") {" ^ true_conc ^ "}" ^ "else {" ^ false_conc
+            ^ "} ",
+            ""
+          )
+    )
   | Struct2str (_, arg_idx, tbl) ->
       let struct_arg =
         ast_c_parameter ^ "->" ^ Option.get (get_member_path walker arg_idx)
@@ -96,23 +327,11 @@ let tostr_logic_to_c ({ walker; _ } as str_state) i tostr =
       let cases = ref [] in
       Hashtbl.iter
         (fun kv_pairs string ->
-          let cond =
-            List.map
-              (fun (key, valu) ->
-                "(" ^ struct_arg ^ "." ^ key ^ " == "
-                ^ ( match valu with
-                  | Bv_const s -> s
-                  | Bool_const b -> if b then "1" else "0"
-                  | Binding s -> s
-                  | Enum_lit e -> add_prefix_unless_exists identifier_prefix e
-                  )
-                ^ ")"
-              )
-              kv_pairs
-          in
-          let cond = String.concat " && " cond in
+          let cond = struct_cond_to_c struct_arg kv_pairs in
           let case =
-            "if (" ^ cond ^ ") { SStream_concat(ss, \"" ^ string ^ "\");} else "
+            "if (" ^ cond ^ ") { "
+            ^ concat_lit_to_c str_state string
+            ^ "} else "
           in
           cases := case :: !cases
         )
@@ -124,49 +343,321 @@ let tostr_logic_to_c ({ walker; _ } as str_state) i tostr =
       let args = List.map (intrinsic_logic_arg_to_c walker) args in
       (name ^ "(" ^ String.concat ", " args ^ sep ^ "ss, ctx);", "")
 
+(* The operations of a part of a subcase, the argument its slot takes, the
+   most characters it writes and the definition of the table it uses *)
+let template_part ({ walker; _ } as str_state) tostr =
+  let member arg_idx =
+    ast_c_parameter ^ "->" ^ Option.get (get_member_path walker arg_idx)
+  in
+  match tostr with
+  | Lit "" -> ([], None, 0, "")
+  | Lit s ->
+      ( "RV_TPL_LIT" :: pooled_literal_bytes str_state s,
+        None,
+        c_literal_length s,
+        ""
+      )
+  | Bitv2Str (name, arg_idx, tbl) | Enum2Str (name, arg_idx, tbl) ->
+      let _, tbl_def = tostr_tbl_to_c str_state name 0 arg_idx tbl in
+      let longest =
+        Hashtbl.fold (fun _ v longest -> max longest (c_literal_length v)) tbl 0
+      in
+      ( ["RV_TPL_TABLE"; string_of_int (template_table_index str_state name)],
+        Some (member arg_idx),
+        longest,
+        tbl_def
+      )
+  | Bool2Str (_, arg_idx, (false_case, true_case)) ->
+      ( ("RV_TPL_BOOL" :: pooled_literal_bytes str_state true_case)
+        @ pooled_literal_bytes str_state false_case,
+        Some (member arg_idx),
+        max (c_literal_length true_case) (c_literal_length false_case),
+        ""
+      )
+  | Struct2str (_, arg_idx, tbl) ->
+      (* the pooled string of the condition that holds, packed as RV_TPL_STR
+         takes it. The values of the struct are distinct, so at most one
+         holds, they are tested in the order of their keys *)
+      let choices =
+        List.map
+          (fun (kv_pairs, string) ->
+            let offset =
+              if string = "" then 0 else pool_offset str_state string
+            in
+            let packed = offset lor (c_literal_length string lsl 16) in
+            "(" ^ struct_cond_to_c (member arg_idx) kv_pairs ^ ") ? "
+            ^ string_of_int packed ^ " : "
+          )
+          (List.sort compare (List.of_seq (Hashtbl.to_seq tbl)))
+      in
+      let longest =
+        Hashtbl.fold (fun _ v longest -> max longest (c_literal_length v)) tbl 0
+      in
+      (["RV_TPL_STR"], Some (String.concat "" choices ^ "0"), longest, "")
+  | Intrinsic_tostr_logic (name, [arg]) ->
+      let ops, bound = Option.get (intrinsic_template_op name) in
+      (ops, Some (intrinsic_logic_arg_to_c walker arg), bound, "")
+  | _ -> failwith "UNREACHABLE"
+
+(* Folds runs of literals into a single one, along with the spc, opt_spc and
+   sep intrinsics, which append fixed strings (see RISCVAst2StrHelpers.h) *)
+let merge_literals body =
+  let as_literal tostr =
+    match tostr with
+    | Lit s -> Some s
+    | Intrinsic_tostr_logic (("spc" | "opt_spc"), []) -> Some " "
+    | Intrinsic_tostr_logic ("sep", []) -> Some " , "
+    | _ -> None
+  in
+  List.fold_right
+    (fun tostr merged ->
+      match (as_literal tostr, merged) with
+      | Some s, Lit next :: rest -> Lit (s ^ next) :: rest
+      | Some s, _ -> Lit s :: merged
+      | None, _ -> tostr :: merged
+    )
+    body []
+
+(* Lowers body into a template, see RISCVAst2StrTemplates.h. Returns its
+   offset and its arguments, None if a part of body has no slot or it can write
+   more than the renderer allows, and the definitions of the tables it uses *)
+let template_of_body str_state body =
+  let body = merge_literals body in
+  if not (List.for_all template_part_supported body) then (None, "")
+  else (
+    let parts = List.map (template_part str_state) body in
+    let tables = String.concat "" (List.map (fun (_, _, _, t) -> t) parts) in
+    let bound =
+      List.fold_left (fun bound (_, _, part, _) -> bound + part) 0 parts
+    in
+    if bound > template_max_bound then (None, tables)
+    else (
+      let bytes =
+        [string_of_int (bound land 0xFF); string_of_int (bound lsr 8)]
+        @ List.concat (List.map (fun (ops, _, _, _) -> ops) parts)
+        @ ["RV_TPL_END"]
+      in
+      let template = String.concat ", " bytes in
+      let offset =
+        match Hashtbl.find_opt str_state.template_offsets template with
+        | Some offset -> offset
+        | None ->
+            let offset = !(str_state.templates_size) in
+            Hashtbl.add str_state.template_offsets template offset;
+            Buffer.add_string str_state.templates (template ^ ", ");
+            str_state.templates_size := offset + List.length bytes;
+            offset
+      in
+      let args = List.filter_map (fun (_, arg, _, _) -> arg) parts in
+      str_state.templates_max_bound :=
+        max bound !(str_state.templates_max_bound);
+      str_state.templates_max_args :=
+        max (List.length args) !(str_state.templates_max_args);
+      (Some (offset, args), tables)
+    )
+  )
+
+let template_call_to_c (offset, args) =
+  let call args_c =
+    "ast2str_template(" ^ string_of_int offset ^ ", " ^ args_c ^ ", ss, ctx);"
+  in
+  if args = [] then call "NULL"
+  else
+    "{const uint64_t args[] = {" ^ String.concat ", " args ^ "};"
+    ^ call "args" ^ "}"
+
 let subcase_body_to_c ({ walker; _ } as str_state) body =
-  let tostrs_and_tables = List.mapi (tostr_logic_to_c str_state) body in
-  let stringified_tostr = String.concat "" (List.map fst tostrs_and_tables) in
-  let tables = String.concat "" (List.map snd tostrs_and_tables) in
+  let template, template_tables =
+    if str_state.format_templates then template_of_body str_state body
+    else (None, "")
+  in
+  match template with
+  | Some template ->
+      (template_call_to_c template, template_tables, Some template)
+  | None ->
+      let body =
+        if str_state.literal_appends then merge_literals body else body
+      in
+      let tostrs_and_tables = List.mapi (tostr_logic_to_c str_state) body in
+      let stringified_tostr =
+        String.concat "" (List.map fst tostrs_and_tables)
+      in
+      let tables = String.concat "" (List.map snd tostrs_and_tables) in
 
-  (stringified_tostr, tables)
+      (stringified_tostr, template_tables ^ tables, None)
 
-let clause_subcase_to_c ({ walker; _ } as str_state)
+(* Returns the code that fills args with the arguments of the template and
+   returns its offset, for ast2str_template_of() *)
+let template_choice_to_c case_name template =
+  match template with
+  | None ->
+      failwith
+        ("Can't generate ast2str_buf(), a subcase of the assembly of "
+       ^ case_name ^ " can't be lowered into a format template"
+        )
+  | Some (offset, args) ->
+      String.concat ""
+        (List.mapi
+           (fun i arg -> "args[" ^ string_of_int i ^ "] = " ^ arg ^ ";")
+           args
+        )
+      ^ "return " ^ string_of_int offset ^ ";"
+
+let clause_subcase_to_c ({ walker; _ } as str_state) case_name
     (subcase_condition, subcase_body) =
-  let subcase_body, tables = subcase_body_to_c str_state subcase_body in
-  let subcase =
+  let subcase_body, tables, template =
+    subcase_body_to_c str_state subcase_body
+  in
+  let guarded code =
     match subcase_condition with
-    | None -> subcase_body
+    | None -> code
     | Some (arg_idx, enum_value) ->
         "if (" ^ ast_c_parameter ^ "->"
         ^ Option.get (get_member_path walker arg_idx)
         ^ " == "
         ^ add_prefix_unless_exists identifier_prefix enum_value
-        ^ ") { " ^ subcase_body ^ "}"
+        ^ ") { " ^ code ^ "}"
   in
-  (subcase, tables)
+  if str_state.ast2str_buf then
+    Buffer.add_string str_state.buf_cases
+      (guarded (template_choice_to_c case_name template));
+  (guarded subcase_body, tables)
+
+(* ast2str() prints every subcase whose condition holds, ast2str_buf() renders
+   the template of the first one only. They agree when the subcases test the
+   same member against different values *)
+let check_exclusive_subcases case_name subcases =
+  let conditions = List.map fst subcases in
+  let exclusive =
+    match List.sort_uniq compare (List.map (Option.map fst) conditions) with
+    | [Some _] ->
+        List.length (List.sort_uniq compare conditions)
+        = List.length conditions
+    | _ -> false
+  in
+  if List.length subcases > 1 && not exclusive then
+    failwith
+      ("Can't generate ast2str_buf(), the subcases of the assembly of "
+     ^ case_name ^ " can hold together"
+      )
 
 let assembler_clause_to_c ({ walker; _ } as str_state) (case_name, subcases) =
   set_walker_case walker case_name;
-  let subconds_and_tables = List.map (clause_subcase_to_c str_state) subcases in
+  let case_label =
+    "case " ^ add_prefix_unless_exists identifier_prefix case_name ^ ": "
+  in
+  if str_state.ast2str_buf then (
+    check_exclusive_subcases case_name subcases;
+    Buffer.add_string str_state.buf_cases case_label
+  );
+  let subconds_and_tables =
+    List.map (clause_subcase_to_c str_state case_name) subcases
+  in
+  if str_state.ast2str_buf then Buffer.add_string str_state.buf_cases "break;";
   let subconds = List.map fst subconds_and_tables in
   let tables = List.map snd subconds_and_tables in
-  let clause =
-    "case "
-    ^ add_prefix_unless_exists identifier_prefix case_name
-    ^ ": " ^ String.concat "" subconds ^ "break;"
-  in
+  let clause = case_label ^ String.concat "" subconds ^ "break;" in
   (clause, String.concat "" tables)
 
-let assembler_to_c asm walker =
+let template_tables_to_c template_table_entries =
+  if !template_table_entries = [] then "NULL" else template_tables_name
+
+let templates_to_c { templates_size; template_table_entries; _ } =
+  if !templates_size = 0 then ""
+  else
+    "static inline void ast2str_template(uint32_t offset, const uint64_t \
+     *args, SStream *ss, RVContext *ctx) {"
+    ^ "rv_template_render(" ^ templates_name ^ " + offset, " ^ pool_name ^ ", "
+    ^ template_tables_to_c template_table_entries
+    ^ ", args, ss, ctx);}"
+
+(* The string pool, the arrays of the pooled tables and the templates, which
+   both ast2str() and ast2str_buf() render, without anything of SStream *)
+let pool_file_to_c
+    ({ pooled_tables; templates; templates_size; template_table_entries; _ } as
+     str_state
+    ) =
+  pool_to_c str_state
+  ^ Buffer.contents pooled_tables
+  ^ ( if !templates_size = 0 then ""
+      else
+        "static const uint8_t " ^ templates_name ^ "[] = {"
+        ^ Buffer.contents templates ^ "};"
+    )
+  ^
+  if !template_table_entries = [] then ""
+  else
+    "static const RVTemplateTable " ^ template_tables_name ^ "[] = {"
+    ^ String.concat ", " (List.rev !template_table_entries)
+    ^ "};"
+
+(* ast2str_buf() fetches the template of the tree with ast2str_template_of(),
+   then renders it into the buffer of the caller *)
+let ast2str_buf_to_c
+    {
+      buf_cases;
+      templates_max_bound;
+      templates_max_args;
+      template_table_entries;
+      _;
+    } =
+  let tree = "const struct " ^ ast_sail_def_name ^ " *" ^ ast_c_parameter in
+  "\n/* ast2str_buf() never writes more characters than this, without the \
+   terminating null */\n#define RISCV_AST2STR_MAX_LEN "
+  ^ string_of_int !templates_max_bound
+  ^ "\n" ^ "static int ast2str_template_of(" ^ tree
+  ^ ", uint64_t *args) { switch (" ^ ast_c_parameter ^ "->" ^ ast_sail_def_name
+  ^ generated_ast_enum_suffix ^ ") {" ^ Buffer.contents buf_cases
+  ^ "} return -1;}" ^ "static size_t ast2str_buf(" ^ tree
+  ^ ", char *dst, size_t cap, const RVContext *ctx) {" ^ "uint64_t args["
+  ^ string_of_int (max 1 !templates_max_args)
+  ^ "];" ^ "int offset = ast2str_template_of(" ^ ast_c_parameter ^ ", args);"
+  ^ "if (offset < 0) { if (cap > 0) { dst[0] = '\\0'; } return 0; }"
+  ^ "return rv_template_render_buf(" ^ templates_name ^ " + offset, "
+  ^ pool_name ^ ", "
+  ^ template_tables_to_c template_table_entries
+  ^ ", args, dst, cap, ctx);}"
+
+let assembler_to_c ?(literal_appends = false) ?(mnemonic_tables = false)
+    ?(format_templates = false) ?(ast2str_buf = false) asm walker =
   let procedure_start =
     "static void ast2str(struct " ^ ast_sail_def_name ^ " *" ^ ast_c_parameter
     ^ ", SStream *ss, RVContext *ctx) { " ^ "switch (" ^ ast_c_parameter ^ "->"
     ^ ast_sail_def_name ^ generated_ast_enum_suffix ^ ") {"
   in
   let procedure_end = "}}" in
-  let initial_state = { walker; already_defined_tables = Hashtbl.create 100 } in
+  let initial_state =
+    {
+      walker;
+      already_defined_tables = Hashtbl.create 100;
+      literal_appends;
+      (* the templates refer to the pooled tables *)
+      mnemonic_tables = mnemonic_tables || format_templates || ast2str_buf;
+      pool = Buffer.create 10000;
+      pool_offsets = Hashtbl.create 1000;
+      pool_size = ref 0;
+      pooled_tables = Buffer.create 10000;
+      format_templates = format_templates || ast2str_buf;
+      templates = Buffer.create 10000;
+      template_offsets = Hashtbl.create 1000;
+      templates_size = ref 0;
+      template_tables = Hashtbl.create 100;
+      template_table_entries = ref [];
+      ast2str_buf;
+      buf_cases = Buffer.create 10000;
+      templates_max_bound = ref 0;
+      templates_max_args = ref 0;
+    }
+  in
   let body_and_tables = List.map (assembler_clause_to_c initial_state) asm in
   let procedure_body = String.concat "" (List.map fst body_and_tables) in
-  let tables = String.concat "" (List.map snd body_and_tables) in
-  (procedure_start ^ procedure_body ^ procedure_end, tables)
+  let tables =
+    String.concat "" (List.map snd body_and_tables)
+    ^ templates_to_c initial_state
+  in
+  let buf = if ast2str_buf then ast2str_buf_to_c initial_state else "" in
+  ( procedure_start ^ procedure_body ^ procedure_end,
+    pool_file_to_c initial_state,
+    tables,
+    buf
+  )
@@ -18,10 +18,16 @@ let includes = ["<stdint.h>"; "<stddef.h>"; "<string.h>"]
 
 let ast_type_filename = "RISCVAst.gen.inc"
 
+let packed_ast_filename = "RISCVAstPacked.gen.inc"
+
 let decode_logic_filename = "RISCVDecode.gen.inc"
 
 let compressed_decode_logic_filename = "RISCVDecodeCompressed.gen.inc"
 
+let decode_id_filename = "RISCVDecodeId.gen.inc"
+
+let control_flow_filename = "RISCVControlFlow.gen.inc"
+
 let identifier_prefix = "RISCV_"
 
 let ast_assembly_mapping = "assembly"
@@ -30,6 +36,10 @@ let assembler_filename = "RISCVAst2Str.gen.inc"
 
 let ast2str_tables_filename = "RISCVAst2StrTbls.gen.inc"
 
+let ast2str_buf_filename = "RISCVAst2StrBuf.gen.inc"
+
+let ast2str_pool_filename = "RISCVAst2StrPool.gen.inc"
+
 let instr_types_filename = "RISCVInsn.gen.inc"
 
 let instr_types_mapping_filename = "RISCVInsnMappings.gen.inc"
@@ -0,0 +1,94 @@
+(* A decoder for control-flow recovery only needs to recognise the instructions
+   transferring control (jumps, branches, traps and returns from traps), which
+   are a handful of the rules of each decoder. Keeping only those rules would
+   change what some inputs decode to though, when an earlier rule shadows a
+   control-flow rule on part of its inputs (e.g. C_JAL and C_ADDIW). Such rules
+   are kept too, and only tell that the input isn't a control transfer.
+
+   Most inputs don't even get to try the kept rules : all the control-flow
+   rules of a decoder assert on a few common bits (the major opcode), so a
+   lookup of those bits in a small table rejects most other inputs at once. *)
+open Decode_bits
+open Decode_analysis
+open Hashset
+
+let read_control_flow_cases path =
+  let cases = Hashtbl.create 20 in
+  List.iter (fun case -> set_add cases case) (Utils.read_file path);
+  cases
+
+let is_control_flow cases rule = set_contains cases (case_name_of_rule rule)
+
+(* The rules to keep, in order, each along with whether it's a control-flow
+   rule or one that shadows a later control-flow rule *)
+let control_flow_rules cases decoder =
+  let rules = Array.of_list decoder in
+  let overlaps = overlap_matrix decoder in
+  let shadows_control_flow i =
+    let shadows = ref false in
+    for j = i + 1 to Array.length rules - 1 do
+      if overlaps.(i).(j) && is_control_flow cases rules.(j) then
+        shadows := true
+    done;
+    !shadows
+  in
+  List.filter_map
+    (fun (i, rule) ->
+      if is_control_flow cases rule then Some (rule, true)
+      else if shadows_control_flow i then Some (rule, false)
+      else None
+    )
+    (List.mapi (fun i rule -> (i, rule)) (Array.to_list rules))
+
+(* Filter keys are made of at most this many bits, the filter table has an
+   entry for every key *)
+let max_filter_key_bits = 8
+
+(* The (start, length) slices whose concatenation, the first slice in the low
+   bits, makes the filter key : the lowest bits that every control-flow rule
+   asserts on *)
+let filter_key_slices control_flow_rules =
+  let common_mask =
+    List.fold_left
+      (fun common (rule, is_cf) ->
+        if is_cf then common land fst (fixed_bits rule) else common
+      )
+      (-1) control_flow_rules
+  in
+  let slices = ref [] in
+  let key_bits = ref 0 in
+  let bit = ref 0 in
+  while !key_bits < max_filter_key_bits && !bit < Sys.int_size - 1 do
+    if common_mask land (1 lsl !bit) <> 0 then (
+      ( match !slices with
+      | (start, len) :: rest when start + len = !bit ->
+          slices := (start, len + 1) :: rest
+      | _ -> slices := (!bit, 1) :: !slices
+      );
+      incr key_bits
+    );
+    incr bit
+  done;
+  List.rev !slices
+
+let filter_key slices input =
+  fst
+    (List.fold_left
+       (fun (key, key_len) (start, len) ->
+         ( key lor (((input lsr start) land ((1 lsl len) - 1)) lsl key_len),
+           key_len + len
+         )
+       )
+       (0, 0) slices
+    )
+
+(* The keys that some control-flow rule may fire on *)
+let filter_keys slices control_flow_rules =
+  List.sort_uniq compare
+    (List.filter_map
+       (fun (rule, is_cf) ->
+         if is_cf then Some (filter_key slices (snd (fixed_bits rule)))
+         else None
+       )
+       control_flow_rules
+    )
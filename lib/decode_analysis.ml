@@ -0,0 +1,158 @@
+(* Facts about how the rules of a decoder relate to each other, derived from
+   what their asserts and map-binds restrict their inputs to (see Decode_bits) :
+
+   - A rule is dead if the earlier rules that always fire on their inputs
+     (no map-binds, no guard) together cover every input it could fire on. It
+     can then never be the first rule to fire, and can be dropped.
+   - Two rules can be swapped if they are disjoint, i.e. no input can satisfy
+     the conditions of both.
+   - The number of rules a decoder tries before it produces an ast case, in the
+     worst case, tells how expensive decoding that case is. *)
+open Decoder
+open Decode_bits
+open Decode_tree
+open Constants
+open Utils
+
+let case_name_of_rule (_, _, (Assign_node_type case, _)) =
+  strip_prefix_if_exists identifier_prefix case
+
+let fires_unconditionally (conditions, guard, _) =
+  guard = True
+  && List.for_all
+       (fun cond -> match cond with Assert _ | Bind _ -> true | _ -> false)
+       conditions
+
+(* Whether every input matching (mask, bits) matches the fixed bits of one of
+   the covering rules. Splits the inputs on a bit that a covering rule fixes
+   until one covering rule matches all of them or none matches any *)
+let rec is_covered (mask, bits) covering =
+  let intersecting =
+    List.filter (fun (m, b) -> m land mask land (b lxor bits) = 0) covering
+  in
+  let is_wider (m, _) = m land lnot mask = 0 in
+  List.exists is_wider intersecting
+  ||
+  match intersecting with
+  | [] -> false
+  | (m, _) :: _ ->
+      let free = m land lnot mask in
+      let bit = free land (-free) in
+      is_covered (mask lor bit, bits) intersecting
+      && is_covered (mask lor bit, bits lor bit) intersecting
+
+(* The index of every dead rule, along with the indices of the earlier rules
+   that cover it *)
+let dead_rules decoder =
+  let unconditional = ref [] in
+  let dead = ref [] in
+  List.iteri
+    (fun i rule ->
+      let ((mask, bits) as fixed) = fixed_bits rule in
+      if is_covered fixed (List.map snd !unconditional) then (
+        let covering =
+          List.filter_map
+            (fun (j, (m, b)) ->
+              if m land mask land (b lxor bits) = 0 then Some j else None
+            )
+            !unconditional
+        in
+        dead := (i, List.rev covering) :: !dead
+      )
+      else if fires_unconditionally rule then
+        unconditional := (i, fixed) :: !unconditional
+    )
+    decoder;
+  List.rev !dead
+
+let drop_dead_rules decoder =
+  let dead = List.map fst (dead_rules decoder) in
+  List.filteri (fun i _ -> not (List.mem i dead)) decoder
+
+(* overlaps.(i).(j) is true iff rules i and j may fire on the same input, and
+   must thus keep their relative order *)
+let overlap_matrix decoder =
+  let constraints = Array.of_list (List.map rule_constraints decoder) in
+  let n = Array.length constraints in
+  Array.init n (fun i ->
+      Array.init n (fun j ->
+          i <> j && not (are_disjoint constraints.(i) constraints.(j))
+      )
+  )
+
+(* For every rule, the earliest position it could be moved to, right after the
+   last earlier rule that it overlaps *)
+let earliest_positions decoder =
+  let overlaps = overlap_matrix decoder in
+  Array.to_list
+    (Array.mapi
+       (fun j row ->
+         let earliest = ref 0 in
+         for i = 0 to j - 1 do
+           if row.(i) then earliest := i + 1
+         done;
+         !earliest
+       )
+       overlaps
+    )
+
+let add_rules_tried worst_cases (rule, tried) =
+  let case = case_name_of_rule rule in
+  match Hashtbl.find_opt worst_cases case with
+  | Some t when t >= tried -> ()
+  | _ -> Hashtbl.replace worst_cases case tried
+
+(* How many rules are tried, at most, before each ast case is produced. A
+   linear decoder tries every rule before the last rule of a case, a decode
+   tree only those before it in the leaves it is in *)
+let worst_case_rules_tried ?(as_tree = false) decoder =
+  let worst_cases = Hashtbl.create 500 in
+  let rec visit tree =
+    match tree with
+    | Leaf rules ->
+        List.iteri (fun i r -> add_rules_tried worst_cases (r, i + 1)) rules
+    | Switch (_, _, branches, default) ->
+        List.iter (fun (_, t) -> visit t) branches;
+        Option.iter visit default
+  in
+  if as_tree then visit (gen_decode_tree decoder)
+  else List.iteri (fun i r -> add_rules_tried worst_cases (r, i + 1)) decoder;
+  List.sort
+    (fun (c1, t1) (c2, t2) -> compare (t2, c1) (t1, c2))
+    (List.of_seq (Hashtbl.to_seq worst_cases))
+
+(* Analyses a decoder as it comes out of the Sail model, and the worst cases of
+   the decoder emitted from it *)
+let report ?(as_tree = false) name decoder emitted =
+  let buf = Buffer.create 10000 in
+  let line fmt = Printf.bprintf buf (fmt ^^ "\n") in
+  let rules = Array.of_list decoder in
+  let rule_name i = string_of_int i ^ ":" ^ case_name_of_rule rules.(i) in
+  line "==== %s : %d rules" name (Array.length rules);
+  line "";
+  let dead = dead_rules decoder in
+  line "Dead rules (%d) :" (List.length dead);
+  List.iter
+    (fun (i, covering) ->
+      line "  %s covered by %s" (rule_name i)
+        (String.concat ", " (List.map rule_name covering))
+    )
+    dead;
+  line "";
+  let live = drop_dead_rules decoder in
+  let live_rules = Array.of_list live in
+  line "Reorderable rules, with the earliest position each can move to :";
+  List.iteri
+    (fun j earliest ->
+      if earliest < j then
+        line "  %d:%s -> %d" j (case_name_of_rule live_rules.(j)) earliest
+    )
+    (earliest_positions live);
+  line "";
+  line "Worst-case number of rules tried per ast case%s :"
+    (if as_tree then " (decode tree)" else "");
+  List.iter
+    (fun (case, tried) -> line "  %s %d" case tried)
+    (worst_case_rules_tried ~as_tree emitted);
+  line "";
+  Buffer.contents buf
@@ -0,0 +1,99 @@
+(* Every Assert condition of a decode rule pins a slice of the input bitstream
+   to a constant. Folding all of them together gives a (mask, match) pair such
+   that the rule can only fire on inputs where (input & mask) == match.
+   The remaining conditions (binds, map-binds and guards) can only make a rule
+   fail further, never succeed on an input outside of its (mask, match) set. *)
+open Decoder
+
+let condition_length cond =
+  match cond with
+  | Assert (len, _)
+  | Bind (len, _)
+  | Map_bind (len, _, _)
+  | Struct_map_bind (len, _, _, _) ->
+      len
+
+let annotate_conds_with_start_offsets conditions =
+  let result = ref [] in
+  let len_consumed_so_far = ref 0 in
+  List.iter
+    (fun cond ->
+      result := (!len_consumed_so_far, cond) :: !result;
+      len_consumed_so_far := !len_consumed_so_far + condition_length cond
+    )
+    conditions;
+  List.rev !result
+
+let rule_length (conditions, _, _) =
+  List.fold_left (fun len cond -> len + condition_length cond) 0 conditions
+
+let slice_mask start len = ((1 lsl len) - 1) lsl start
+
+let fixed_bits (conditions, _, _) =
+  List.fold_left
+    (fun (mask, bits) (start, cond) ->
+      match cond with
+      | Assert (len, value) ->
+          ( mask lor slice_mask start len,
+            bits lor (int_of_string value lsl start)
+          )
+      | _ -> (mask, bits)
+    )
+    (0, 0)
+    (annotate_conds_with_start_offsets conditions)
+
+(* All the (start, length) slices that some rule asserts on *)
+let asserted_slices rules =
+  let slices = Hashtbl.create 50 in
+  List.iter
+    (fun (conditions, _, _) ->
+      List.iter
+        (fun (start, cond) ->
+          match cond with
+          | Assert (len, _) -> Hashtbl.replace slices (start, len) ()
+          | _ -> ()
+        )
+        (annotate_conds_with_start_offsets conditions)
+    )
+    rules;
+  List.sort compare (List.of_seq (Hashtbl.to_seq_keys slices))
+
+(* Each Map_bind or Struct_map_bind condition only lets through inputs whose
+   slice holds one of the keys of its table *)
+let map_bind_keys (conditions, _, _) =
+  let table_keys tbl =
+    List.map int_of_string (List.of_seq (Hashtbl.to_seq_keys tbl))
+  in
+  List.filter_map
+    (fun (start, cond) ->
+      match cond with
+      | Map_bind (len, tbl, _) -> Some ((start, len), table_keys tbl)
+      | Struct_map_bind (len, _, tbl, _) -> Some ((start, len), table_keys tbl)
+      | _ -> None
+    )
+    (annotate_conds_with_start_offsets conditions)
+
+(* What the asserts and map-binds of a rule restrict its inputs to *)
+let rule_constraints rule = (fixed_bits rule, map_bind_keys rule)
+
+(* Whether no input can satisfy the conditions of both rules. Guards are
+   ignored, so rules that only differ by their guards are never disjoint *)
+let are_disjoint ((mask1, bits1), map_binds1) ((mask2, bits2), map_binds2) =
+  let accepts_key (mask, bits) map_binds (start, len) key =
+    let all_ones = (1 lsl len) - 1 in
+    key land ((mask lsr start) land all_ones) = (bits lsr start) land all_ones
+    &&
+    match List.assoc_opt (start, len) map_binds with
+    | Some keys -> List.mem key keys
+    | None -> true
+  in
+  let excludes map_binds other_fixed other_map_binds =
+    List.exists
+      (fun (slice, keys) ->
+        not (List.exists (accepts_key other_fixed other_map_binds slice) keys)
+      )
+      map_binds
+  in
+  mask1 land mask2 land (bits1 lxor bits2) <> 0
+  || excludes map_binds1 (mask2, bits2) map_binds2
+  || excludes map_binds2 (mask1, bits1) map_binds1
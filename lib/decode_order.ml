@@ -0,0 +1,72 @@
+(* The rules of a decoder are tried in order and the first one to fire wins, but
+   two rules that can never fire on the same input can be swapped without
+   changing how any input decodes. Given how often each ast case occurs in a
+   real corpus, the rules of the most frequent cases can thus be moved ahead of
+   the rules they are disjoint from, so that decoding typical code tries fewer
+   rules. Rules that may overlap always keep their relative order.
+
+   A frequency profile is a text file with an ast case name and a count on each
+   line, e.g. "LOAD 1234" or "RISCV_C_ADDI 567". Cases that it doesn't mention
+   count as 0, and lines starting with '#' are comments. *)
+open Decode_analysis
+open Constants
+open Utils
+
+let read_rule_frequencies path =
+  let frequencies = Hashtbl.create 500 in
+  List.iter
+    (fun line ->
+      let words =
+        String.split_on_char ' ' line |> List.filter (fun w -> w <> "")
+      in
+      match words with
+      | [] -> ()
+      | w :: _ when w.[0] = '#' -> ()
+      | [case; count] ->
+          Hashtbl.replace frequencies
+            (strip_prefix_if_exists identifier_prefix case)
+            (int_of_string count)
+      | _ ->
+          failwith
+            ("Malformed line in frequency profile " ^ path ^ " : " ^ line)
+    )
+    (read_file path);
+  frequencies
+
+(* A greedy stable topological sort : repeatedly emit the most frequent rule
+   that no earlier overlapping rule is still waiting on, the earliest such rule
+   on ties. The earliest rule not yet emitted is always eligible, so this never
+   gets stuck, and without any frequencies it's the identity *)
+let order_by_frequency frequencies decoder =
+  let rules = Array.of_list decoder in
+  let n = Array.length rules in
+  let overlaps = overlap_matrix decoder in
+  let frequency i =
+    Option.value ~default:0
+      (Hashtbl.find_opt frequencies (case_name_of_rule rules.(i)))
+  in
+  (* How many earlier rules overlapping each rule are still waiting *)
+  let num_waiting_on = Array.make n 0 in
+  for j = 0 to n - 1 do
+    for i = 0 to j - 1 do
+      if overlaps.(i).(j) then num_waiting_on.(j) <- num_waiting_on.(j) + 1
+    done
+  done;
+  let emitted = Array.make n false in
+  let order = ref [] in
+  for _ = 1 to n do
+    let best = ref (-1) in
+    for i = 0 to n - 1 do
+      if
+        (not emitted.(i))
+        && num_waiting_on.(i) = 0
+        && (!best < 0 || frequency i > frequency !best)
+      then best := i
+    done;
+    emitted.(!best) <- true;
+    order := rules.(!best) :: !order;
+    for j = !best + 1 to n - 1 do
+      if overlaps.(!best).(j) then num_waiting_on.(j) <- num_waiting_on.(j) - 1
+    done
+  done;
+  List.rev !order
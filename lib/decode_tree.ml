@@ -0,0 +1,127 @@
+(* A decoder can also be laid out as a decision tree over its rules : instead of
+   trying every rule in order, first switch on a slice of the input that most
+   rules assert on (e.g. the major opcode), then on another slice within each
+   branch (e.g. funct3), and so on until a branch is left with only a handful of
+   rules, which are then tried in order exactly like the linear decoder does.
+
+   Each branch keeps every rule that could fire on an input reaching it, in
+   their original relative order. The first rule to fire in a branch is thus the
+   first rule to fire in the whole decoder, i.e. first-match semantics are
+   preserved even where rules overlap. Rules that don't restrict all the bits of
+   the switched slice are copied into every branch they are compatible with, as
+   well as into the default branch. *)
+open Decoder
+open Decode_bits
+
+type decode_tree =
+  | Leaf of decoder
+  (* The start offset and length of the switched slice, a subtree for each value
+     that some rule restricts the slice to, and an optional subtree for all the
+     other values *)
+  | Switch of int * int * (int * decode_tree) list * decode_tree option
+
+(* Rule lists shorter than this are cheaper to try in order than to dispatch on *)
+let min_rules_to_split = 4
+
+type split = {
+  slice : int * int;
+  (* Values of the slice that some rule restricts it to, ascending *)
+  keys : int list;
+  (* How many rules restrict all the bits of the slice *)
+  num_fully_restricting : int;
+}
+
+let slice_of_fixed_bits (start, len) (mask, bits) =
+  let all_ones = (1 lsl len) - 1 in
+  ((mask lsr start) land all_ones, (bits lsr start) land all_ones)
+
+(* The values a rule restricts a slice of the input to, if it restricts all of
+   the slice's bits : either a single asserted value, or the keys of the table
+   of a map-bind over exactly that slice *)
+let slice_values ((_, len) as slice) (rule, fixed) =
+  let mask, bits = slice_of_fixed_bits slice fixed in
+  if mask = (1 lsl len) - 1 then Some [bits]
+  else if mask <> 0 then None
+  else List.assoc_opt slice (map_bind_keys rule)
+
+let is_fully_restricting slice rule = Option.is_some (slice_values slice rule)
+
+let is_compatible_with slice key ((_, fixed) as rule) =
+  match slice_values slice rule with
+  | Some values -> List.mem key values
+  | None ->
+      let mask, bits = slice_of_fixed_bits slice fixed in
+      key land mask = bits
+
+(* A split is only worth it if every branch drops some rules, which requires at
+   least 2 keys and also guards against slices that all the restricting rules
+   restrict to the same set of values (e.g. exhaustive map-binds) *)
+let evaluate_split rules_with_fixed_bits slice =
+  let restricted_values =
+    List.filter_map (slice_values slice) rules_with_fixed_bits
+  in
+  let keys = List.sort_uniq compare (List.flatten restricted_values) in
+  let drops_some_rules key =
+    List.exists (fun values -> not (List.mem key values)) restricted_values
+  in
+  if List.length keys >= 2 && List.for_all drops_some_rules keys then
+    Some
+      {
+        slice;
+        keys;
+        num_fully_restricting = List.length restricted_values;
+      }
+  else None
+
+(* Prefer slices that the most rules restrict, then those splitting the rules
+   into the most branches *)
+let is_better_split s1 s2 =
+  compare
+    (s1.num_fully_restricting, List.length s1.keys)
+    (s2.num_fully_restricting, List.length s2.keys)
+  > 0
+
+let find_best_split rules_with_fixed_bits =
+  List.fold_left
+    (fun best slice ->
+      match (evaluate_split rules_with_fixed_bits slice, best) with
+      | None, _ -> best
+      | Some candidate, Some b when not (is_better_split candidate b) -> best
+      | candidate, _ -> candidate
+    )
+    None
+    (asserted_slices (List.map fst rules_with_fixed_bits))
+
+(* Terminates because every branch of a split drops some rules, and the default
+   branch drops all the fully restricting rules *)
+let rec build_tree rules_with_fixed_bits =
+  let leaf = Leaf (List.map fst rules_with_fixed_bits) in
+  if List.length rules_with_fixed_bits < min_rules_to_split then leaf
+  else (
+    match find_best_split rules_with_fixed_bits with
+    | None -> leaf
+    | Some { slice = (start, len) as slice; keys; _ } ->
+        let branches =
+          List.map
+            (fun key ->
+              let compatible =
+                List.filter (is_compatible_with slice key) rules_with_fixed_bits
+              in
+              (key, build_tree compatible)
+            )
+            keys
+        in
+        let default =
+          match
+            List.filter
+              (fun r -> not (is_fully_restricting slice r))
+              rules_with_fixed_bits
+          with
+          | [] -> None
+          | rest -> Some (build_tree rest)
+        in
+        Switch (start, len, branches, default)
+  )
+
+let gen_decode_tree decoder =
+  build_tree (List.map (fun rule -> (rule, fixed_bits rule)) decoder)
@@ -105,6 +105,7 @@ type guard =
   | Or of guard * guard
   | Not of guard
   | True
+  | False
 
 type decode_rule = conditions * guard * consequences
 
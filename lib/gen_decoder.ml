@@ -40,7 +40,7 @@ let vec_concat_to_consequence_body slices =
          match slice with
          | MP_lit (L_aux (lit, _) as l) -> (
              match lit with
-             | L_bin _ | L_hex _ -> Bv_const (bitv_literal_to_str l)
+             | L_bin _ | L_hex _ -> Bv_const (bitv_literal_to_sized_str l)
              | _ -> failwith "UNREACHABLE"
            )
          | MP_id i -> Binding (id_to_str i)
@@ -221,7 +221,7 @@ let flatten_bv_concat_args a1 a2 =
     match a with
     | E_id i -> [id_to_str i]
     | E_lit (L_aux (L_bin _, _) as lit) | E_lit (L_aux (L_hex _, _) as lit) ->
-        [bitv_literal_to_str lit]
+        [bitv_literal_to_sized_str lit]
     | E_app (i, [a1; a2]) when id_to_str i = "bitvector_concat" ->
         flatten_arg a1 @ flatten_arg a2
     | _ -> failwith "UNREACHABLE"
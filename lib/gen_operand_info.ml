@@ -130,21 +130,55 @@ let get_arg_idx arg_id args =
     args;
   if !arg_idx <> -1 then Some !arg_idx else None
 
+(* The literal bits appended to an immediate in a concatenation, as the number
+   of bits and their value *)
+let appended_literal_bits pats =
+  List.fold_left
+    (fun (shift, value) p ->
+      match p with
+      | MP_aux (MP_lit (L_aux (L_bin s, _) as lit), _) ->
+          let size = bitv_literal_size lit in
+          (shift + size, (value lsl size) lor int_of_string ("0b" ^ s))
+      | MP_aux (MP_lit (L_aux (L_hex s, _) as lit), _) ->
+          let size = bitv_literal_size lit in
+          (shift + size, (value lsl size) lor int_of_string ("0x" ^ s))
+      | _ -> failwith "Expected only literals after the immediate"
+    )
+    (0, 0) pats
+
+let imm_format_of_function fun_name (shift, low_bits) =
+  let width prefix =
+    if str_starts_with prefix fun_name then
+      int_of_string_opt
+        (String.sub fun_name (String.length prefix)
+           (String.length fun_name - String.length prefix)
+        )
+    else None
+  in
+  match (width "hex_bits_signed_", width "hex_bits_") with
+  | Some bits, _ -> { bits; is_signed = true; shift; low_bits }
+  | _, Some bits -> { bits; is_signed = false; shift; low_bits }
+  | _ -> { bits = 64; is_signed = false; shift; low_bits }
+
 let infer_immediate_in_pattern p args =
   let arg_index_from_arg_pattern arg =
     match arg with
-    | MP_aux (MP_id i, _) -> get_arg_idx i args
+    | MP_aux (MP_id i, _) ->
+        Option.map (fun idx -> (idx, (0, 0))) (get_arg_idx i args)
     | MP_aux (MP_vector_concat pats, _) ->
         let indices =
           List.filter_map
-            (fun p ->
+            (fun (pos, p) ->
+              let after = List.filteri (fun i _ -> i > pos) pats in
               match p with
-              | MP_aux (MP_id i, _) -> get_arg_idx i args
+              | MP_aux (MP_id i, _)
               | MP_aux (MP_typ (MP_aux (MP_id i, _), _), _) ->
-                  get_arg_idx i args
+                  Option.map
+                    (fun idx -> (idx, appended_literal_bits after))
+                    (get_arg_idx i args)
               | _ -> None
             )
-            pats
+            (List.mapi (fun pos p -> (pos, p)) pats)
         in
         assert_empty_or_length1_or_failwith indices
           "Expected a vector concatentation expresion to have at most 1 id";
@@ -154,7 +188,11 @@ let infer_immediate_in_pattern p args =
   match p with
   | MP_aux (MP_app (fun_id, [arg]), _)
     when str_starts_with "hex_bits" (id_to_str fun_id) ->
-      arg_index_from_arg_pattern arg
+      Option.map
+        (fun (idx, appended) ->
+          Imm (idx, imm_format_of_function (id_to_str fun_id) appended)
+        )
+        (arg_index_from_arg_pattern arg)
   | _ -> None
 
 let infer_immediates state _ id _ left right =
@@ -167,15 +205,12 @@ let infer_immediates state _ id _ left right =
             | MPat_aux (MPat_pat pr, _) | MPat_aux (MPat_when (pr, _), _) -> (
                 match pr with
                 | MP_aux (MP_string_append patterns, _) ->
-                    let imm_indices =
+                    let imms =
                       List.filter_map
                         (fun p -> infer_immediate_in_pattern p args)
                         patterns
                     in
-                    if List.length imm_indices <> 0 then (
-                      let imms =
-                        List.map (fun index -> Imm index) imm_indices
-                      in
+                    if List.length imms <> 0 then (
                       let case_name = id_to_str case_id in
                       if Hashtbl.mem state.op_info.immediates_info case_name
                       then (
@@ -186,7 +221,9 @@ let infer_immediates state _ id _ left right =
                           if List.length imms <> List.length existing then true
                           else
                             List.combine imms existing
-                            |> List.map (fun (Imm i1, Imm i2) -> i1 = i2)
+                            |> List.map (fun (Imm (i1, _), Imm (i2, _)) ->
+                                   i1 = i2
+                               )
                             |> List.for_all (fun eq -> eq)
                         in
                         if mismatch then
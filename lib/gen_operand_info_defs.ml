@@ -5,7 +5,12 @@ type regfile = Base | Base_or_Float | Float_or_Double | Vector
 type regaccess = Read | Write | Read_and_Write
 type reg_operand = Reg of int * regfile * regaccess
 
-type imm_operand = Imm of int
+(* How the assembly shows an immediate : in bits bits, signed or not, after
+   appending shift low bits of value low_bits to the ast member (e.g. the offset
+   of c.j is shown with its always zero low bit) *)
+type imm_format = { bits : int; is_signed : bool; shift : int; low_bits : int }
+
+type imm_operand = Imm of int * imm_format
 
 (* The mapping is from ast cases to a list of ("specializations", operand list) pairs
    A "specialization" is either None, or a pair of an argument index and argument value
@@ -0,0 +1,209 @@
+(* A hart profile pins down the parts of the decoding context that a family of
+   targets never changes at runtime : XLEN, FLEN, and which extensions are known
+   to be enabled or known to be absent. Given one, every guard of the decoders
+   that only depends on those is folded at generation time, rules whose guards
+   fold to false are dropped, and so are the stringification and operand cases
+   of AST nodes that no remaining rule produces.
+
+   Extensions that a profile neither enables nor excludes are still checked at
+   runtime, exactly like in the unspecialised decoders.
+
+   A profile is a text file with one directive per line :
+        xlen 64
+        flen 64
+        enable M A F D C Zca Zcd
+        exclude V Zvbb Zvkb
+   Extension names can be given with or without their Sail "Ext_" prefix, and
+   lines starting with '#' are comments. *)
+open Decoder
+open Gen_operand_info_defs
+open Constants
+open Hashset
+open Utils
+
+type hart_profile = {
+  xlen : int;
+  flen : int;
+  enabled_extensions : string set;
+  excluded_extensions : string set;
+}
+
+let extension_prefix = "Ext_"
+
+(* Extensions whose currentlyEnabled() clause in the Sail model requires
+   FLEN >= 64 *)
+let extensions_needing_flen64 = ["Ext_D"; "Ext_Zdinx"]
+
+let read_profile path =
+  let xlen = ref None in
+  let flen = ref 0 in
+  let enabled = Hashtbl.create 50 in
+  let excluded = Hashtbl.create 50 in
+  let add_extensions set exts =
+    List.iter
+      (fun e -> set_add set (add_prefix_unless_exists extension_prefix e))
+      exts
+  in
+  List.iter
+    (fun line ->
+      let words =
+        String.split_on_char ' '
+          (String.map (fun c -> if c = '\t' then ' ' else c) line)
+        |> List.filter (fun w -> w <> "")
+      in
+      match words with
+      | [] -> ()
+      | w :: _ when w.[0] = '#' -> ()
+      | ["xlen"; n] -> xlen := int_of_string_opt n
+      | ["flen"; n] -> flen := int_of_string n
+      | "enable" :: exts -> add_extensions enabled exts
+      | "exclude" :: exts -> add_extensions excluded exts
+      | _ -> failwith ("Malformed line in hart profile " ^ path ^ " : " ^ line)
+    )
+    (read_file path);
+  let xlen =
+    match !xlen with
+    | Some ((32 | 64) as x) -> x
+    | _ -> failwith ("Hart profile " ^ path ^ " must set xlen to 32 or 64")
+  in
+  if !flen < 64 then add_extensions excluded extensions_needing_flen64;
+  Hashtbl.iter
+    (fun ext () ->
+      if set_contains excluded ext then
+        failwith
+          ("Hart profile " ^ path ^ " both enables and excludes " ^ ext
+         ^ ", note that flen < 64 excludes "
+          ^ String.concat " and " extensions_needing_flen64
+          )
+    )
+    enabled;
+  {
+    xlen;
+    flen = !flen;
+    enabled_extensions = enabled;
+    excluded_extensions = excluded;
+  }
+
+(* Functions called by the decoders' guards that are shorthands for "any of
+   these extensions is currently enabled", as defined in RISCVDecodeHelpers.h *)
+let extension_predicates =
+  [
+    ("haveDoubleFPU", ["Ext_D"; "Ext_Zdinx"]);
+    ("haveSingleFPU", ["Ext_F"; "Ext_Zfinx"]);
+    ("haveHalfFPU", ["Ext_Zfh"; "Ext_Zhinx"]);
+    ("haveHalfMin", ["Ext_Zfh"; "Ext_Zhinx"; "Ext_Zfhmin"]);
+  ]
+
+let any_extension_enabled profile exts =
+  if List.exists (set_contains profile.enabled_extensions) exts then Some true
+  else if List.for_all (set_contains profile.excluded_extensions) exts then
+    Some false
+  else None
+
+let int_operand_value profile bound_ids op =
+  match op with
+  | Number n -> Some n
+  | Ident name when not (List.mem name bound_ids) -> (
+      match name with
+      | "xlen" -> Some profile.xlen
+      | "xlen_bytes" -> Some (profile.xlen / 8)
+      | "flen" -> Some profile.flen
+      | _ -> None
+    )
+  | _ -> None
+
+let guard_of_bool b = if b then True else False
+
+let rec fold_guard profile bound_ids guard =
+  let fold = fold_guard profile bound_ids in
+  let fold_comparison cmp op1 op2 =
+    match
+      ( int_operand_value profile bound_ids op1,
+        int_operand_value profile bound_ids op2
+      )
+    with
+    | Some v1, Some v2 -> guard_of_bool (cmp v1 v2)
+    | _ -> guard
+  in
+  let fold_extension_check exts =
+    match any_extension_enabled profile exts with
+    | Some enabled -> guard_of_bool enabled
+    | None -> guard
+  in
+  match guard with
+  (* Mirrors the C operators that ccodegen_decode_procedure emits *)
+  | Eq_int (op1, op2) -> fold_comparison ( = ) op1 op2
+  | Less_eq_int (op1, op2) -> fold_comparison ( < ) op1 op2
+  | Less_eq_or_eq (op1, op2) -> fold_comparison ( <= ) op1 op2
+  | Boolfun ("currentlyEnabled", [ext]) -> fold_extension_check [ext]
+  | Boolfun (name, []) when List.mem_assoc name extension_predicates ->
+      fold_extension_check (List.assoc name extension_predicates)
+  | And (g1, g2) -> (
+      match (fold g1, fold g2) with
+      | False, _ | _, False -> False
+      | True, g | g, True -> g
+      | g1, g2 -> And (g1, g2)
+    )
+  | Or (g1, g2) -> (
+      match (fold g1, fold g2) with
+      | True, _ | _, True -> True
+      | False, g | g, False -> g
+      | g1, g2 -> Or (g1, g2)
+    )
+  | Not g -> (
+      match fold g with True -> False | False -> True | g -> Not g
+    )
+  | _ -> guard
+
+let bound_identifiers conditions =
+  List.filter_map
+    (fun cond ->
+      match cond with
+      | Assert _ -> None
+      | Bind (_, id) | Map_bind (_, _, id) | Struct_map_bind (_, _, _, id) ->
+          Some id
+    )
+    conditions
+
+(* A rule whose guard folds to false can never fire, so dropping it doesn't
+   change which rule fires first on any input *)
+let specialize_decoder profile decoder =
+  List.filter_map
+    (fun (conditions, guard, consequences) ->
+      match fold_guard profile (bound_identifiers conditions) guard with
+      | False -> None
+      | guard -> Some (conditions, guard, consequences)
+    )
+    decoder
+
+let produced_cases decoders =
+  let cases = Hashtbl.create 500 in
+  List.iter
+    (fun (_, _, (Assign_node_type case, _)) ->
+      set_add cases (add_prefix_unless_exists identifier_prefix case)
+    )
+    (List.flatten decoders);
+  cases
+
+let is_produced cases case_name =
+  set_contains cases (add_prefix_unless_exists identifier_prefix case_name)
+
+(* The string tables are emitted on their first use by a clause, so the tables
+   only used by dropped clauses go away with them *)
+let specialize_stringifier produced_cases (asm : Stringifier.stringifier) =
+  List.filter (fun (case_name, _) -> is_produced produced_cases case_name) asm
+
+let specialize_operand_info produced_cases info =
+  let keep_produced tbl =
+    let tbl = Hashtbl.copy tbl in
+    Hashtbl.filter_map_inplace
+      (fun case_name v ->
+        if is_produced produced_cases case_name then Some v else None
+      )
+      tbl;
+    tbl
+  in
+  {
+    registers_info = keep_produced info.registers_info;
+    immediates_info = keep_produced info.immediates_info;
+  }
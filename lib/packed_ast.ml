@@ -0,0 +1,83 @@
+(* A layout packing every ast case into a single 64-bit word : the ast case in
+   the low bits, then the members of the case one after the other, each taking
+   only as many bits as its values need (the width of a bitvector, enough bits
+   to tell apart the constants of an enum). The members of nested structs are
+   laid out like the members of the case itself. *)
+open Clike_typedef
+
+type packed_field = {
+  (* below the ast payload, e.g. utype.imm *)
+  path : string;
+  (* a Clike_builtin, Clike_enum or Clike_typename *)
+  leaf : clike_typedef;
+  offset : int;
+  width : int;
+}
+
+type packed_case = { case_name : string; fields : packed_field list }
+
+type packed_layout = { case_bits : int; cases : packed_case list }
+
+let packed_bits = 64
+
+let bits_for num_values =
+  let bits = ref 1 in
+  while 1 lsl !bits < num_values do
+    incr bits
+  done;
+  !bits
+
+let leaf_width enum_sizes leaf =
+  match leaf with
+  | Clike_builtin (_, Clike_bitfield size) -> size
+  | Clike_builtin (_, Clike_byte) -> 8
+  | Clike_builtin (_, Clike_word) -> 16
+  | Clike_builtin (_, Clike_dword) -> 32
+  | Clike_builtin (_, Clike_qword) -> 64
+  | Clike_enum (typname, _, constants) ->
+      Hashtbl.replace enum_sizes ("enum " ^ typname) (List.length constants);
+      bits_for (List.length constants)
+  | Clike_typename (typname, _) -> bits_for (Hashtbl.find enum_sizes typname)
+  | _ -> failwith "Expected a leaf type"
+
+let rec leaves prefix typ =
+  match typ with
+  | Clike_struct (_, name, members) ->
+      List.concat_map (leaves (prefix ^ name ^ ".")) members
+  | Clike_builtin (name, _) | Clike_enum (_, name, _) | Clike_typename (_, name)
+    ->
+      [(prefix ^ name, typ)]
+  | Clike_void -> []
+  | Clike_union _ -> failwith "Can't pack a union nested in an ast case"
+
+let gen_packed_layout typedef =
+  match typedef with
+  | Clike_struct
+      (_, _, [Clike_enum (_, _, case_names); Clike_union (_, _, bodies)]) ->
+      let case_bits = bits_for (List.length case_names) in
+      let enum_sizes = Hashtbl.create 50 in
+      let pack_case case_name body =
+        (* a case that isn't a struct has a single member *)
+        let case_leaves =
+          match body with
+          | Clike_struct ("", name, members) ->
+              List.concat_map (leaves (name ^ ".")) members
+          | _ -> leaves "" body
+        in
+        let offset = ref case_bits in
+        let field_of_leaf (path, leaf) =
+          let width = leaf_width enum_sizes leaf in
+          let field = { path; leaf; offset = !offset; width } in
+          offset := !offset + width;
+          field
+        in
+        let fields = List.map field_of_leaf case_leaves in
+        if !offset > packed_bits then
+          failwith
+            ("Ast case " ^ case_name ^ " needs " ^ string_of_int !offset
+           ^ " bits, can't pack it into " ^ string_of_int packed_bits
+            );
+        { case_name; fields }
+      in
+      { case_bits; cases = List.map2 pack_case case_names bodies }
+  | _ -> invalid_arg "Expected the ast typedef generated by Gen_clike_typedef"
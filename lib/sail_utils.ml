@@ -69,6 +69,15 @@ let bitv_literal_to_str bitv_lit =
   | L_bin lit_str -> "0x" ^ binary_str_to_hex_str lit_str
   | _ -> failwith "Expected a bitvec literal, found neither L_hex nor L_bin"
 
+(* Keeps the base the literal is written in, which tells its width : 0b0 is a
+   single bit while 0x0 is four *)
+let bitv_literal_to_sized_str bitv_lit =
+  let (L_aux (lit, _)) = bitv_lit in
+  match lit with
+  | L_hex lit_str -> "0x" ^ lit_str
+  | L_bin lit_str -> "0b" ^ lit_str
+  | _ -> failwith "Expected a bitvec literal, found neither L_hex nor L_bin"
+
 let bitv_literal_size bitv_lit =
   let (L_aux (lit, _)) = bitv_lit in
   match lit with
@@ -50,6 +50,16 @@ let str_starts_with prefix str =
     str_prefix = prefix
   )
 
+(* For the literals of bitv_literal_to_sized_str *)
+let sized_bitv_str_width s =
+  let digits = String.length s - 2 in
+  if str_starts_with "0b" s then digits else digits * 4
+
+let sized_bitv_str_to_c s =
+  if str_starts_with "0b" s then
+    "0x" ^ binary_str_to_hex_str (String.sub s 2 (String.length s - 2))
+  else s
+
 let add_prefix_unless_exists prefix str =
   if str_starts_with prefix str then str else prefix ^ str
 
@@ -0,0 +1,1278 @@
+#ifndef __RISCV_AST2STR_RENDER_H__
+#define __RISCV_AST2STR_RENDER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../../cs_priv.h"
+#include "RISCVDecodeHelpers.h"
+#include "RISCVRVContextHelpers.h"
+
+// The writers of the text of ast2str at a pointer, each returning the length
+// of what it wrote, and the renderer of the format templates built on them.
+// Nothing here depends on SStream : the helpers of RISCVAst2StrHelpers.h and
+// rv_template_render() of RISCVAst2StrTemplates.h append their text to a
+// stream, ast2str_buf() of -ast2str-buf renders into a buffer of the caller
+// with only this header and the pool of RISCVAst2StrPool.gen.inc
+
+// Copies the string literal lit to out, evaluates to its length
+#define lit_to(out, lit) (memcpy(out, lit, sizeof(lit) - 1), sizeof(lit) - 1)
+
+// The 8 hex digits of x as ASCII, in the bytes of the result from the lowest
+// one, most significant digit first. The nibbles are spread to one per byte
+// by halving the lanes three times, and 'a' - '9' - 1 is added to the bytes
+// holding a digit above 9, those that carry into their high nibble when 6 is
+// added
+static inline uint64_t hex_digits_swar(uint32_t x) {
+  uint64_t v = ((uint64_t)(x & 0xFFFF) << 32) | (x >> 16);
+  v = ((v & 0x000000FF000000FFULL) << 16) | ((v >> 8) & 0x000000FF000000FFULL);
+  v = ((v & 0x000F000F000F000FULL) << 8) | ((v >> 4) & 0x000F000F000F000FULL);
+  uint64_t letters =
+      ((v + 0x0606060606060606ULL) >> 4) & 0x0101010101010101ULL;
+  return v + 0x3030303030303030ULL + letters * ('a' - '9' - 1);
+}
+
+// Stores the 8 bytes of bytes at out, the lowest one first
+static inline void store_bytes(char *out, uint64_t bytes) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  memcpy(out, &bytes, sizeof(bytes));
+#else
+  for (int i = 0; i < 8; i++) {
+    out[i] = (char)(bytes >> (8 * i));
+  }
+#endif
+}
+
+// Writes "0x" and the low ndigits hex digits of bitvec at out, which must have
+// room for 18 characters whatever ndigits is
+static inline void hex_digits_to(char *out, uint64_t bitvec, uint8_t ndigits) {
+  // the digits to write at the top
+  uint64_t v = ndigits == 16 ? bitvec : bitvec << (64 - 4 * ndigits);
+  out[0] = '0';
+  out[1] = 'x';
+  store_bytes(out + 2, hex_digits_swar((uint32_t)(v >> 32)));
+  if (ndigits > 8) {
+    store_bytes(out + 10, hex_digits_swar((uint32_t)v));
+  }
+}
+
+// Writes what hex_bits_signed() appends at out, which must have room for 19
+// characters, returns its length
+static inline size_t hex_bits_signed_to(char *out, uint64_t bitvec,
+                                        uint8_t bvlen_bits) {
+  uint8_t ndigits = (bvlen_bits + 3) / 4;
+  size_t len = 0;
+  // is negative ?
+  if ((bitvec & (1 << (bvlen_bits - 1))) != 0) {
+    out[len++] = '-';
+  }
+  hex_digits_to(out + len, bitvec, ndigits);
+  return len + 2 + ndigits;
+}
+
+// The names of each register file are pooled into a single string, along
+// with the offset and the length of each name in it
+static const char reg_name_pool[] =
+    "zero" "ra" "sp" "gp" "tp" "t0" "t1" "t2" "fp" "s1" "a0" "a1" "a2" "a3" "a4"
+    "a5" "a6" "a7" "s2" "s3" "s4" "s5" "s6" "s7" "s8" "s9" "s10" "s11" "t3" "t4"
+    "t5" "t6";
+static const uint8_t reg_name_offsets[] = {
+    0, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30, 32, 34, 36, 38, 40,
+    42, 44, 46, 48, 50, 52, 54, 57, 60, 62, 64, 66};
+static const uint8_t reg_name_lengths[] = {
+    4, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    2, 3, 3, 2, 2, 2, 2};
+
+static const char creg_name_pool[] = "s0" "s1" "a0" "a1" "a2" "a3" "a4" "a5";
+static const uint8_t creg_name_offsets[] = {0, 2, 4, 6, 8, 10, 12, 14};
+static const uint8_t creg_name_lengths[] = {2, 2, 2, 2, 2, 2, 2, 2};
+
+static const char freg_name_pool[] =
+    "ft0" "ft1" "ft2" "ft3" "ft4" "ft5" "ft6" "ft7" "fs0" "fs1" "fa0" "fa1"
+    "fa2" "fa3" "fa4" "fa5" "fa6" "fa7" "fs2" "fs3" "fs4" "fs5" "fs6" "fs7"
+    "fs8" "fs9" "fs10" "fs11" "ft8" "ft9" "ft10" "ft11";
+static const uint8_t freg_name_offsets[] = {
+    0, 3, 6, 9, 12, 15, 18, 21, 24, 27, 30, 33, 36, 39, 42, 45, 48, 51, 54, 57,
+    60, 63, 66, 69, 72, 75, 78, 82, 86, 89, 92, 96};
+static const uint8_t freg_name_lengths[] = {
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 4, 4, 3, 3, 4, 4};
+
+static const char vreg_name_pool[] =
+    "v0" "v1" "v2" "v3" "v4" "v5" "v6" "v7" "v8" "v9" "v10" "v11" "v12" "v13"
+    "v14" "v15" "v16" "v17" "v18" "v19" "v20" "v21" "v22" "v23" "v24" "v25"
+    "v26" "v27" "v28" "v29" "v30" "v31";
+static const uint8_t vreg_name_offsets[] = {
+    0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 23, 26, 29, 32, 35, 38, 41, 44, 47,
+    50, 53, 56, 59, 62, 65, 68, 71, 74, 77, 80, 83};
+static const uint8_t vreg_name_lengths[] = {
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3};
+static inline size_t maybe_vmask_to(char *out, uint8_t vm) {
+  if (vm) {
+    return 0;
+  }
+  return lit_to(out, " , v0.t");
+}
+
+static inline size_t ta_flag_to(char *out, uint8_t ta) {
+  if (ta) {
+    return lit_to(out, "ta");
+  } else {
+    return lit_to(out, "tu");
+  }
+}
+
+static inline size_t ma_flag_to(char *out, uint8_t ma) {
+  if (ma) {
+    return lit_to(out, "ma");
+  } else {
+    return lit_to(out, "mu");
+  }
+}
+
+static inline size_t maybe_lmul_flag_to(char *out, uint8_t lmul) {
+  switch (lmul) {
+  case 0x0:
+    return 0;
+
+  case 0x5:
+    return lit_to(out, " , mf8");
+
+  case 0x6:
+    return lit_to(out, " , mf4");
+
+  case 0x7:
+    return lit_to(out, " , mf2");
+
+  case 0x1:
+    return lit_to(out, " , m2");
+
+  case 0x2:
+    return lit_to(out, " , m4");
+
+  case 0x3:
+    return lit_to(out, " , m8");
+  }
+  return 0;
+}
+
+// out must have room for 14 characters
+static inline size_t csr_name_map_to(char *out, uint32_t csr) {
+  switch (csr) {
+  case 0x3a0:
+    return lit_to(out, "pmpcfg0");
+
+  case 0x3a1:
+    return lit_to(out, "pmpcfg1");
+
+  case 0x3a2:
+    return lit_to(out, "pmpcfg2");
+
+  case 0x3a3:
+    return lit_to(out, "pmpcfg3");
+
+  case 0x3a4:
+    return lit_to(out, "pmpcfg4");
+
+  case 0x3a5:
+    return lit_to(out, "pmpcfg5");
+
+  case 0x3a6:
+    return lit_to(out, "pmpcfg6");
+
+  case 0x3a7:
+    return lit_to(out, "pmpcfg7");
+
+  case 0x3a8:
+    return lit_to(out, "pmpcfg8");
+
+  case 0x3a9:
+    return lit_to(out, "pmpcfg9");
+
+  case 0x3aa:
+    return lit_to(out, "pmpcfg10");
+
+  case 0x3ab:
+    return lit_to(out, "pmpcfg11");
+
+  case 0x3ac:
+    return lit_to(out, "pmpcfg12");
+
+  case 0x3ad:
+    return lit_to(out, "pmpcfg13");
+
+  case 0x3ae:
+    return lit_to(out, "pmpcfg14");
+
+  case 0x3af:
+    return lit_to(out, "pmpcfg15");
+
+  case 0x3b0:
+    return lit_to(out, "pmpaddr0");
+
+  case 0x3b1:
+    return lit_to(out, "pmpaddr1");
+
+  case 0x3b2:
+    return lit_to(out, "pmpaddr2");
+
+  case 0x3b3:
+    return lit_to(out, "pmpaddr3");
+
+  case 0x3b4:
+    return lit_to(out, "pmpaddr4");
+
+  case 0x3b5:
+    return lit_to(out, "pmpaddr5");
+
+  case 0x3b6:
+    return lit_to(out, "pmpaddr6");
+
+  case 0x3b7:
+    return lit_to(out, "pmpaddr7");
+
+  case 0x3b8:
+    return lit_to(out, "pmpaddr8");
+
+  case 0x3b9:
+    return lit_to(out, "pmpaddr9");
+
+  case 0x3ba:
+    return lit_to(out, "pmpaddr10");
+
+  case 0x3bb:
+    return lit_to(out, "pmpaddr11");
+
+  case 0x3bc:
+    return lit_to(out, "pmpaddr12");
+
+  case 0x3bd:
+    return lit_to(out, "pmpaddr13");
+
+  case 0x3be:
+    return lit_to(out, "pmpaddr14");
+
+  case 0x3bf:
+    return lit_to(out, "pmpaddr15");
+
+  case 0x3c0:
+    return lit_to(out, "pmpaddr16");
+
+  case 0x3c1:
+    return lit_to(out, "pmpaddr17");
+
+  case 0x3c2:
+    return lit_to(out, "pmpaddr18");
+
+  case 0x3c3:
+    return lit_to(out, "pmpaddr19");
+
+  case 0x3c4:
+    return lit_to(out, "pmpaddr20");
+
+  case 0x3c5:
+    return lit_to(out, "pmpaddr21");
+
+  case 0x3c6:
+    return lit_to(out, "pmpaddr22");
+
+  case 0x3c7:
+    return lit_to(out, "pmpaddr23");
+
+  case 0x3c8:
+    return lit_to(out, "pmpaddr24");
+
+  case 0x3c9:
+    return lit_to(out, "pmpaddr25");
+
+  case 0x3ca:
+    return lit_to(out, "pmpaddr26");
+
+  case 0x3cb:
+    return lit_to(out, "pmpaddr27");
+
+  case 0x3cc:
+    return lit_to(out, "pmpaddr28");
+
+  case 0x3cd:
+    return lit_to(out, "pmpaddr29");
+
+  case 0x3ce:
+    return lit_to(out, "pmpaddr30");
+
+  case 0x3cf:
+    return lit_to(out, "pmpaddr31");
+
+  case 0x3d0:
+    return lit_to(out, "pmpaddr32");
+
+  case 0x3d1:
+    return lit_to(out, "pmpaddr33");
+
+  case 0x3d2:
+    return lit_to(out, "pmpaddr34");
+
+  case 0x3d3:
+    return lit_to(out, "pmpaddr35");
+
+  case 0x3d4:
+    return lit_to(out, "pmpaddr36");
+
+  case 0x3d5:
+    return lit_to(out, "pmpaddr37");
+
+  case 0x3d6:
+    return lit_to(out, "pmpaddr38");
+
+  case 0x3d7:
+    return lit_to(out, "pmpaddr39");
+
+  case 0x3d8:
+    return lit_to(out, "pmpaddr40");
+
+  case 0x3d9:
+    return lit_to(out, "pmpaddr41");
+
+  case 0x3da:
+    return lit_to(out, "pmpaddr42");
+
+  case 0x3db:
+    return lit_to(out, "pmpaddr43");
+
+  case 0x3dc:
+    return lit_to(out, "pmpaddr44");
+
+  case 0x3dd:
+    return lit_to(out, "pmpaddr45");
+
+  case 0x3de:
+    return lit_to(out, "pmpaddr46");
+
+  case 0x3df:
+    return lit_to(out, "pmpaddr47");
+
+  case 0x3e0:
+    return lit_to(out, "pmpaddr48");
+
+  case 0x3e1:
+    return lit_to(out, "pmpaddr49");
+
+  case 0x3e2:
+    return lit_to(out, "pmpaddr50");
+
+  case 0x3e3:
+    return lit_to(out, "pmpaddr51");
+
+  case 0x3e4:
+    return lit_to(out, "pmpaddr52");
+
+  case 0x3e5:
+    return lit_to(out, "pmpaddr53");
+
+  case 0x3e6:
+    return lit_to(out, "pmpaddr54");
+
+  case 0x3e7:
+    return lit_to(out, "pmpaddr55");
+
+  case 0x3e8:
+    return lit_to(out, "pmpaddr56");
+
+  case 0x3e9:
+    return lit_to(out, "pmpaddr57");
+
+  case 0x3ea:
+    return lit_to(out, "pmpaddr58");
+
+  case 0x3eb:
+    return lit_to(out, "pmpaddr59");
+
+  case 0x3ec:
+    return lit_to(out, "pmpaddr60");
+
+  case 0x3ed:
+    return lit_to(out, "pmpaddr61");
+
+  case 0x3ee:
+    return lit_to(out, "pmpaddr62");
+
+  case 0x3ef:
+    return lit_to(out, "pmpaddr63");
+
+  case 0x180:
+    return lit_to(out, "satp");
+
+  case 0x321:
+    return lit_to(out, "mcyclecfg");
+
+  case 0x721:
+    return lit_to(out, "mcyclecfgh");
+
+  case 0x322:
+    return lit_to(out, "minstretcfg");
+
+  case 0x722:
+    return lit_to(out, "minstretcfgh");
+
+  case 0x14d:
+    return lit_to(out, "stimecmp");
+
+  case 0x15d:
+    return lit_to(out, "stimecmph");
+
+  case 0x301:
+    return lit_to(out, "misa");
+
+  case 0x300:
+    return lit_to(out, "mstatus");
+
+  case 0x30a:
+    return lit_to(out, "menvcfg");
+
+  case 0x31a:
+    return lit_to(out, "menvcfgh");
+
+  case 0x10a:
+    return lit_to(out, "senvcfg");
+
+  case 0x304:
+    return lit_to(out, "mie");
+
+  case 0x344:
+    return lit_to(out, "mip");
+
+  case 0x302:
+    return lit_to(out, "medeleg");
+
+  case 0x312:
+    return lit_to(out, "medelegh");
+
+  case 0x303:
+    return lit_to(out, "mideleg");
+
+  case 0x342:
+    return lit_to(out, "mcause");
+
+  case 0x343:
+    return lit_to(out, "mtval");
+
+  case 0x340:
+    return lit_to(out, "mscratch");
+
+  case 0x106:
+    return lit_to(out, "scounteren");
+
+  case 0x306:
+    return lit_to(out, "mcounteren");
+
+  case 0x320:
+    return lit_to(out, "mcountinhibit");
+
+  case 0xf11:
+    return lit_to(out, "mvendorid");
+
+  case 0xf12:
+    return lit_to(out, "marchid");
+
+  case 0xf13:
+    return lit_to(out, "mimpid");
+
+  case 0xf14:
+    return lit_to(out, "mhartid");
+
+  case 0xf15:
+    return lit_to(out, "mconfigptr");
+
+  case 0x100:
+    return lit_to(out, "sstatus");
+
+  case 0x144:
+    return lit_to(out, "sip");
+
+  case 0x104:
+    return lit_to(out, "sie");
+
+  case 0x140:
+    return lit_to(out, "sscratch");
+
+  case 0x142:
+    return lit_to(out, "scause");
+
+  case 0x143:
+    return lit_to(out, "stval");
+
+  case 0x7a0:
+    return lit_to(out, "tselect");
+
+  case 0x7a1:
+    return lit_to(out, "tdata1");
+
+  case 0x7a2:
+    return lit_to(out, "tdata2");
+
+  case 0x7a3:
+    return lit_to(out, "tdata3");
+
+  case 0x015:
+    return lit_to(out, "seed");
+
+  case 0xb83:
+    return lit_to(out, "mhpmcounter3h");
+
+  case 0xb84:
+    return lit_to(out, "mhpmcounter4h");
+
+  case 0xb85:
+    return lit_to(out, "mhpmcounter5h");
+
+  case 0xb86:
+    return lit_to(out, "mhpmcounter6h");
+
+  case 0xb87:
+    return lit_to(out, "mhpmcounter7h");
+
+  case 0xb88:
+    return lit_to(out, "mhpmcounter8h");
+
+  case 0xb89:
+    return lit_to(out, "mhpmcounter9h");
+
+  case 0xb8a:
+    return lit_to(out, "mhpmcounter10h");
+
+  case 0xb8b:
+    return lit_to(out, "mhpmcounter11h");
+
+  case 0xb8c:
+    return lit_to(out, "mhpmcounter12h");
+
+  case 0xb8d:
+    return lit_to(out, "mhpmcounter13h");
+
+  case 0xb8e:
+    return lit_to(out, "mhpmcounter14h");
+
+  case 0xb8f:
+    return lit_to(out, "mhpmcounter15h");
+
+  case 0xb90:
+    return lit_to(out, "mhpmcounter16h");
+
+  case 0xb91:
+    return lit_to(out, "mhpmcounter17h");
+
+  case 0xb92:
+    return lit_to(out, "mhpmcounter18h");
+
+  case 0xb93:
+    return lit_to(out, "mhpmcounter19h");
+
+  case 0xb94:
+    return lit_to(out, "mhpmcounter20h");
+
+  case 0xb95:
+    return lit_to(out, "mhpmcounter21h");
+
+  case 0xb96:
+    return lit_to(out, "mhpmcounter22h");
+
+  case 0xb97:
+    return lit_to(out, "mhpmcounter23h");
+
+  case 0xb98:
+    return lit_to(out, "mhpmcounter24h");
+
+  case 0xb99:
+    return lit_to(out, "mhpmcounter25h");
+
+  case 0xb9a:
+    return lit_to(out, "mhpmcounter26h");
+
+  case 0xb9b:
+    return lit_to(out, "mhpmcounter27h");
+
+  case 0xb9c:
+    return lit_to(out, "mhpmcounter28h");
+
+  case 0xb9d:
+    return lit_to(out, "mhpmcounter29h");
+
+  case 0xb9e:
+    return lit_to(out, "mhpmcounter30h");
+
+  case 0xb9f:
+    return lit_to(out, "mhpmcounter31h");
+
+  case 0xda0:
+    return lit_to(out, "scountovf");
+
+  case 0x001:
+    return lit_to(out, "fflags");
+
+  case 0x002:
+    return lit_to(out, "frm");
+
+  case 0x003:
+    return lit_to(out, "fcsr");
+
+  case 0xc00:
+    return lit_to(out, "cycle");
+
+  case 0xc01:
+    return lit_to(out, "time");
+
+  case 0xc02:
+    return lit_to(out, "instret");
+
+  case 0xc80:
+    return lit_to(out, "cycleh");
+
+  case 0xc81:
+    return lit_to(out, "timeh");
+
+  case 0xc82:
+    return lit_to(out, "instreth");
+
+  case 0xb00:
+    return lit_to(out, "mcycle");
+
+  case 0xb02:
+    return lit_to(out, "minstret");
+
+  case 0xb80:
+    return lit_to(out, "mcycleh");
+
+  case 0xb82:
+    return lit_to(out, "minstreth");
+
+  case 0xc03:
+    return lit_to(out, "hpmcounter3");
+
+  case 0xc04:
+    return lit_to(out, "hpmcounter4");
+
+  case 0xc05:
+    return lit_to(out, "hpmcounter5");
+
+  case 0xc06:
+    return lit_to(out, "hpmcounter6");
+
+  case 0xc07:
+    return lit_to(out, "hpmcounter7");
+
+  case 0xc08:
+    return lit_to(out, "hpmcounter8");
+
+  case 0xc09:
+    return lit_to(out, "hpmcounter9");
+
+  case 0xc0a:
+    return lit_to(out, "hpmcounter10");
+
+  case 0xc0b:
+    return lit_to(out, "hpmcounter11");
+
+  case 0xc0c:
+    return lit_to(out, "hpmcounter12");
+
+  case 0xc0d:
+    return lit_to(out, "hpmcounter13");
+
+  case 0xc0e:
+    return lit_to(out, "hpmcounter14");
+
+  case 0xc0f:
+    return lit_to(out, "hpmcounter15");
+
+  case 0xc10:
+    return lit_to(out, "hpmcounter16");
+
+  case 0xc11:
+    return lit_to(out, "hpmcounter17");
+
+  case 0xc12:
+    return lit_to(out, "hpmcounter18");
+
+  case 0xc13:
+    return lit_to(out, "hpmcounter19");
+
+  case 0xc14:
+    return lit_to(out, "hpmcounter20");
+
+  case 0xc15:
+    return lit_to(out, "hpmcounter21");
+
+  case 0xc16:
+    return lit_to(out, "hpmcounter22");
+
+  case 0xc17:
+    return lit_to(out, "hpmcounter23");
+
+  case 0xc18:
+    return lit_to(out, "hpmcounter24");
+
+  case 0xc19:
+    return lit_to(out, "hpmcounter25");
+
+  case 0xc1a:
+    return lit_to(out, "hpmcounter26");
+
+  case 0xc1b:
+    return lit_to(out, "hpmcounter27");
+
+  case 0xc1c:
+    return lit_to(out, "hpmcounter28");
+
+  case 0xc1d:
+    return lit_to(out, "hpmcounter29");
+
+  case 0xc1e:
+    return lit_to(out, "hpmcounter30");
+
+  case 0xc1f:
+    return lit_to(out, "hpmcounter31");
+
+  case 0xc83:
+    return lit_to(out, "hpmcounter3h");
+
+  case 0xc84:
+    return lit_to(out, "hpmcounter4h");
+
+  case 0xc85:
+    return lit_to(out, "hpmcounter5h");
+
+  case 0xc86:
+    return lit_to(out, "hpmcounter6h");
+
+  case 0xc87:
+    return lit_to(out, "hpmcounter7h");
+
+  case 0xc88:
+    return lit_to(out, "hpmcounter8h");
+
+  case 0xc89:
+    return lit_to(out, "hpmcounter9h");
+
+  case 0xc8a:
+    return lit_to(out, "hpmcounter10h");
+
+  case 0xc8b:
+    return lit_to(out, "hpmcounter11h");
+
+  case 0xc8c:
+    return lit_to(out, "hpmcounter12h");
+
+  case 0xc8d:
+    return lit_to(out, "hpmcounter13h");
+
+  case 0xc8e:
+    return lit_to(out, "hpmcounter14h");
+
+  case 0xc8f:
+    return lit_to(out, "hpmcounter15h");
+
+  case 0xc90:
+    return lit_to(out, "hpmcounter16h");
+
+  case 0xc91:
+    return lit_to(out, "hpmcounter17h");
+
+  case 0xc92:
+    return lit_to(out, "hpmcounter18h");
+
+  case 0xc93:
+    return lit_to(out, "hpmcounter19h");
+
+  case 0xc94:
+    return lit_to(out, "hpmcounter20h");
+
+  case 0xc95:
+    return lit_to(out, "hpmcounter21h");
+
+  case 0xc96:
+    return lit_to(out, "hpmcounter22h");
+
+  case 0xc97:
+    return lit_to(out, "hpmcounter23h");
+
+  case 0xc98:
+    return lit_to(out, "hpmcounter24h");
+
+  case 0xc99:
+    return lit_to(out, "hpmcounter25h");
+
+  case 0xc9a:
+    return lit_to(out, "hpmcounter26h");
+
+  case 0xc9b:
+    return lit_to(out, "hpmcounter27h");
+
+  case 0xc9c:
+    return lit_to(out, "hpmcounter28h");
+
+  case 0xc9d:
+    return lit_to(out, "hpmcounter29h");
+
+  case 0xc9e:
+    return lit_to(out, "hpmcounter30h");
+
+  case 0xc9f:
+    return lit_to(out, "hpmcounter31h");
+
+  case 0x323:
+    return lit_to(out, "mhpmevent3");
+
+  case 0x324:
+    return lit_to(out, "mhpmevent4");
+
+  case 0x325:
+    return lit_to(out, "mhpmevent5");
+
+  case 0x326:
+    return lit_to(out, "mhpmevent6");
+
+  case 0x327:
+    return lit_to(out, "mhpmevent7");
+
+  case 0x328:
+    return lit_to(out, "mhpmevent8");
+
+  case 0x329:
+    return lit_to(out, "mhpmevent9");
+
+  case 0x32a:
+    return lit_to(out, "mhpmevent10");
+
+  case 0x32b:
+    return lit_to(out, "mhpmevent11");
+
+  case 0x32c:
+    return lit_to(out, "mhpmevent12");
+
+  case 0x32d:
+    return lit_to(out, "mhpmevent13");
+
+  case 0x32e:
+    return lit_to(out, "mhpmevent14");
+
+  case 0x32f:
+    return lit_to(out, "mhpmevent15");
+
+  case 0x330:
+    return lit_to(out, "mhpmevent16");
+
+  case 0x331:
+    return lit_to(out, "mhpmevent17");
+
+  case 0x332:
+    return lit_to(out, "mhpmevent18");
+
+  case 0x333:
+    return lit_to(out, "mhpmevent19");
+
+  case 0x334:
+    return lit_to(out, "mhpmevent20");
+
+  case 0x335:
+    return lit_to(out, "mhpmevent21");
+
+  case 0x336:
+    return lit_to(out, "mhpmevent22");
+
+  case 0x337:
+    return lit_to(out, "mhpmevent23");
+
+  case 0x338:
+    return lit_to(out, "mhpmevent24");
+
+  case 0x339:
+    return lit_to(out, "mhpmevent25");
+
+  case 0x33a:
+    return lit_to(out, "mhpmevent26");
+
+  case 0x33b:
+    return lit_to(out, "mhpmevent27");
+
+  case 0x33c:
+    return lit_to(out, "mhpmevent28");
+
+  case 0x33d:
+    return lit_to(out, "mhpmevent29");
+
+  case 0x33e:
+    return lit_to(out, "mhpmevent30");
+
+  case 0x33f:
+    return lit_to(out, "mhpmevent31");
+
+  case 0xb03:
+    return lit_to(out, "mhpmcounter3");
+
+  case 0xb04:
+    return lit_to(out, "mhpmcounter4");
+
+  case 0xb05:
+    return lit_to(out, "mhpmcounter5");
+
+  case 0xb06:
+    return lit_to(out, "mhpmcounter6");
+
+  case 0xb07:
+    return lit_to(out, "mhpmcounter7");
+
+  case 0xb08:
+    return lit_to(out, "mhpmcounter8");
+
+  case 0xb09:
+    return lit_to(out, "mhpmcounter9");
+
+  case 0xb0a:
+    return lit_to(out, "mhpmcounter10");
+
+  case 0xb0b:
+    return lit_to(out, "mhpmcounter11");
+
+  case 0xb0c:
+    return lit_to(out, "mhpmcounter12");
+
+  case 0xb0d:
+    return lit_to(out, "mhpmcounter13");
+
+  case 0xb0e:
+    return lit_to(out, "mhpmcounter14");
+
+  case 0xb0f:
+    return lit_to(out, "mhpmcounter15");
+
+  case 0xb10:
+    return lit_to(out, "mhpmcounter16");
+
+  case 0xb11:
+    return lit_to(out, "mhpmcounter17");
+
+  case 0xb12:
+    return lit_to(out, "mhpmcounter18");
+
+  case 0xb13:
+    return lit_to(out, "mhpmcounter19");
+
+  case 0xb14:
+    return lit_to(out, "mhpmcounter20");
+
+  case 0xb15:
+    return lit_to(out, "mhpmcounter21");
+
+  case 0xb16:
+    return lit_to(out, "mhpmcounter22");
+
+  case 0xb17:
+    return lit_to(out, "mhpmcounter23");
+
+  case 0xb18:
+    return lit_to(out, "mhpmcounter24");
+
+  case 0xb19:
+    return lit_to(out, "mhpmcounter25");
+
+  case 0xb1a:
+    return lit_to(out, "mhpmcounter26");
+
+  case 0xb1b:
+    return lit_to(out, "mhpmcounter27");
+
+  case 0xb1c:
+    return lit_to(out, "mhpmcounter28");
+
+  case 0xb1d:
+    return lit_to(out, "mhpmcounter29");
+
+  case 0xb1e:
+    return lit_to(out, "mhpmcounter30");
+
+  case 0xb1f:
+    return lit_to(out, "mhpmcounter31");
+
+  case 0x105:
+    return lit_to(out, "stvec");
+
+  case 0x141:
+    return lit_to(out, "sepc");
+
+  case 0x305:
+    return lit_to(out, "mtvec");
+
+  case 0x341:
+    return lit_to(out, "mepc");
+
+  case 0x008:
+    return lit_to(out, "vstart");
+
+  case 0x009:
+    return lit_to(out, "vxsat");
+
+  case 0x00a:
+    return lit_to(out, "vxrm");
+
+  case 0x00f:
+    return lit_to(out, "vcsr");
+
+  case 0xc20:
+    return lit_to(out, "vl");
+
+  case 0xc21:
+    return lit_to(out, "vtype");
+
+  case 0xc22:
+    return lit_to(out, "vlenb");
+
+  default:
+    // as hex_bits_12()
+    hex_digits_to(out, csr, 3);
+    return 5;
+  }
+}
+
+static inline size_t fence_bits_to(char *out, uint8_t bits) {
+  size_t len = 0;
+  if (bits & 0x8) {
+    out[len++] = 'i';
+  }
+  if (bits & 0x4) {
+    out[len++] = 'o';
+  }
+  if (bits & 0x2) {
+    out[len++] = 'r';
+  }
+  if (bits & 0x1) {
+    out[len++] = 'w';
+  }
+  return len;
+}
+
+// Writes the n low bits of val in binary at out, most significant bit first.
+// Each byte of val is spread to one bit per byte by a multiply, the mask keeps
+// bit 7 - i in byte i, and adding 0x7F carries it to the top of its byte. out
+// must have room for n rounded up to a multiple of 8 characters
+static inline void bin_digits_to(char *out, uint64_t val, uint32_t n) {
+  for (uint32_t done = 0; done < n; done += 8) {
+    uint32_t chunk = n - done < 8 ? n - done : 8;
+    // the next chunk bits, from the top of the byte
+    uint64_t byte = ((val >> (n - done - chunk)) << (8 - chunk)) & 0xFF;
+    uint64_t bits = (byte * 0x0101010101010101ULL) & 0x0102040810204080ULL;
+    bits = ((bits + 0x7F7F7F7F7F7F7F7FULL) >> 7) & 0x0101010101010101ULL;
+    store_bytes(out + done, bits + 0x3030303030303030ULL);
+  }
+}
+
+// A template is a byte string : the most characters it can write, on 2 bytes
+// little-endian, then its operations up to RV_TPL_END. Literals are
+// (offset, length) pairs into the string pool of ast2str, the offset on 2
+// bytes little-endian. Every slot but RV_TPL_LIT takes the next argument in
+// order. The renderer checks once that the whole template fits, and writes
+// straight into its output, templates are not specific to ast2str though and
+// other front ends can walk them with their own slots
+enum {
+  RV_TPL_END,
+  // offset, length
+  RV_TPL_LIT,
+  RV_TPL_REG,
+  RV_TPL_CREG,
+  RV_TPL_FREG,
+  RV_TPL_VREG,
+  RV_TPL_FREG_OR_REG,
+  // bits, as hex_bits_<bits>()
+  RV_TPL_HEX,
+  // bits, as hex_bits_signed_<bits>()
+  RV_TPL_HEX_SIGNED,
+  // bits, as dec_bits_<bits>()
+  RV_TPL_BIN,
+  RV_TPL_FENCE,
+  RV_TPL_CSR,
+  RV_TPL_VMASK,
+  RV_TPL_LMUL,
+  RV_TPL_TA,
+  RV_TPL_MA,
+  // offset and length if true, offset and length if false
+  RV_TPL_BOOL,
+  // index into the tables given to rv_template_render()
+  RV_TPL_TABLE,
+  // a string of the pool chosen by the argument, its offset in the low 16
+  // bits and its length above
+  RV_TPL_STR,
+};
+
+// The generator counts this many characters for the slots other than
+// RV_TPL_LIT, RV_TPL_BOOL, RV_TPL_TABLE, RV_TPL_STR and RV_TPL_BIN, whose
+// size it knows. It is enough for the digits the hex helpers write past the
+// text
+#define RV_TPL_SLOT_MAX 24
+
+// The generator doesn't lower subcases that can write more than this
+#define RV_TPL_MAX_BOUND 256
+
+// A table of strings of the pool, indexed by the value of an enum or a
+// bitvector. Values past count, or left out of the table, print nothing
+typedef struct RVTemplateTable {
+  const uint16_t *offsets;
+  const uint8_t *lengths;
+  uint16_t count;
+} RVTemplateTable;
+
+static inline size_t tpl_pooled_to(char *out, const char *pool,
+                                   const uint8_t *op) {
+  uint8_t len = op[2];
+  memcpy(out, pool + (op[0] | (op[1] << 8)), len);
+  return len;
+}
+
+static inline size_t tpl_name_to(char *out, const char *pool,
+                                 const uint8_t *offsets,
+                                 const uint8_t *lengths, uint8_t r) {
+  memcpy(out, pool + offsets[r], lengths[r]);
+  return lengths[r];
+}
+
+// The most characters rendering tpl can write
+static inline size_t rv_template_bound(const uint8_t *tpl) {
+  return tpl[0] | (tpl[1] << 8);
+}
+
+// Writes the text of the template tpl, whose literals are in pool, with args
+// at out, which must have room for its bound. Returns the length of the text
+static inline size_t rv_template_render_to(char *out, const uint8_t *tpl,
+                                           const char *pool,
+                                           const RVTemplateTable *tables,
+                                           const uint64_t *args,
+                                           const RVContext *ctx) {
+  char *start = out;
+  const uint8_t *op = tpl + 2;
+  while (*op != RV_TPL_END) {
+    uint8_t r;
+    switch (*op++) {
+    case RV_TPL_LIT:
+      out += tpl_pooled_to(out, pool, op);
+      op += 3;
+      break;
+    case RV_TPL_REG:
+      r = (uint8_t)*args++;
+      CS_ASSERT(r < 32);
+      out += tpl_name_to(out, reg_name_pool, reg_name_offsets,
+                         reg_name_lengths, r);
+      break;
+    case RV_TPL_CREG:
+      r = (uint8_t)*args++;
+      CS_ASSERT(r < 8);
+      out += tpl_name_to(out, creg_name_pool, creg_name_offsets,
+                         creg_name_lengths, r);
+      break;
+    case RV_TPL_FREG:
+      r = (uint8_t)*args++;
+      CS_ASSERT(r < 32);
+      out += tpl_name_to(out, freg_name_pool, freg_name_offsets,
+                         freg_name_lengths, r);
+      break;
+    case RV_TPL_VREG:
+      r = (uint8_t)*args++;
+      CS_ASSERT(r < 32);
+      out += tpl_name_to(out, vreg_name_pool, vreg_name_offsets,
+                         vreg_name_lengths, r);
+      break;
+    case RV_TPL_FREG_OR_REG:
+      r = (uint8_t)*args++;
+      CS_ASSERT(r < 32);
+      // as freg_or_reg_name()
+      if (HART_SUPPORTS(Ext_Zfinx)) {
+        out += tpl_name_to(out, reg_name_pool, reg_name_offsets,
+                           reg_name_lengths, r);
+      } else {
+        out += tpl_name_to(out, freg_name_pool, freg_name_offsets,
+                           freg_name_lengths, r);
+      }
+      break;
+    case RV_TPL_HEX: {
+      uint8_t ndigits = (*op++ + 3) / 4;
+      hex_digits_to(out, *args++, ndigits);
+      out += 2 + ndigits;
+      break;
+    }
+    case RV_TPL_HEX_SIGNED:
+      out += hex_bits_signed_to(out, *args++, *op++);
+      break;
+    case RV_TPL_BIN:
+      bin_digits_to(out, *args++, *op);
+      out += *op++;
+      break;
+    case RV_TPL_FENCE:
+      out += fence_bits_to(out, (uint8_t)*args++);
+      break;
+    case RV_TPL_CSR:
+      out += csr_name_map_to(out, (uint32_t)*args++);
+      break;
+    case RV_TPL_VMASK:
+      out += maybe_vmask_to(out, (uint8_t)*args++);
+      break;
+    case RV_TPL_LMUL:
+      out += maybe_lmul_flag_to(out, (uint8_t)*args++);
+      break;
+    case RV_TPL_TA:
+      out += ta_flag_to(out, (uint8_t)*args++);
+      break;
+    case RV_TPL_MA:
+      out += ma_flag_to(out, (uint8_t)*args++);
+      break;
+    case RV_TPL_BOOL:
+      out += tpl_pooled_to(out, pool, *args++ ? op : op + 3);
+      op += 6;
+      break;
+    case RV_TPL_TABLE: {
+      const RVTemplateTable *table = &tables[*op++];
+      uint64_t member = *args++;
+      if (member < table->count) {
+        memcpy(out, pool + table->offsets[member], table->lengths[member]);
+        out += table->lengths[member];
+      }
+      break;
+    }
+    case RV_TPL_STR: {
+      uint64_t str = *args++;
+      memcpy(out, pool + (str & 0xFFFF), str >> 16);
+      out += str >> 16;
+      break;
+    }
+    default:
+      CS_ASSERT(0 && "unknown template operation");
+      return out - start;
+    }
+  }
+  return out - start;
+}
+
+// Writes the text of the template tpl into the cap bytes of dst as snprintf()
+// would : it is truncated to cap - 1 characters if it doesn't fit, and
+// terminated unless cap is 0. Returns the length of the whole text
+static inline size_t rv_template_render_buf(const uint8_t *tpl,
+                                            const char *pool,
+                                            const RVTemplateTable *tables,
+                                            const uint64_t *args, char *dst,
+                                            size_t cap, const RVContext *ctx) {
+  size_t len;
+  if (cap > rv_template_bound(tpl)) {
+    len = rv_template_render_to(dst, tpl, pool, tables, args, ctx);
+    dst[len] = '\0';
+    return len;
+  }
+  char scratch[RV_TPL_MAX_BOUND];
+  CS_ASSERT(rv_template_bound(tpl) <= sizeof(scratch));
+  len = rv_template_render_to(scratch, tpl, pool, tables, args, ctx);
+  if (cap > 0) {
+    size_t copied = len < cap ? len : cap - 1;
+    memcpy(dst, scratch, copied);
+    dst[copied] = '\0';
+  }
+  return len;
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef __RISCV_AST2STR_TEMPLATES_H__
+#define __RISCV_AST2STR_TEMPLATES_H__
+
+#include "RISCVAst2StrHelpers.h"
+
+// The renderer of the format templates that the generator emits into
+// RISCVAst2StrPool.gen.inc when run with -format-templates. Each subcase of
+// the assembly mapping whose parts all have a slot is lowered into a
+// template, and ast2str() only gathers the members it prints into an array
+// before calling ast2str_template() with it. The others keep their
+// straight-line code
+//
+// The format of the templates and the renderer itself are in
+// RISCVAst2StrRender.h, this appends the text it renders to an SStream
+//
+// Near the end of the buffer the template is rendered into a scratch buffer
+// and appended as a whole, nothing is appended if it doesn't fit. With
+// -ast2str-buf, ast2str_buf() renders the same templates into a buffer of the
+// caller, without an SStream, an allocation or a printf-family call, from
+// RISCVAst2StrRender.h alone
+
+// Appends the text of the template tpl to ss
+static inline void rv_template_render(const uint8_t *tpl, const char *pool,
+                                      const RVTemplateTable *tables,
+                                      const uint64_t *args, SStream *ss,
+                                      RVContext *ctx) {
+#ifdef SSTREAM_RETURN_IF_CLOSED
+  SSTREAM_RETURN_IF_CLOSED(ss);
+#endif
+  size_t bound = rv_template_bound(tpl);
+  char scratch[RV_TPL_MAX_BOUND];
+  CS_ASSERT(bound <= sizeof(scratch));
+  if (ss->index + bound >= sizeof(ss->buffer)) {
+    ss_append(ss, scratch,
+              rv_template_render_to(scratch, tpl, pool, tables, args, ctx));
+    return;
+  }
+  ss->index += rv_template_render_to(ss->buffer + ss->index, tpl, pool,
+                                     tables, args, ctx);
+  ss->buffer[ss->index] = '\0';
+}
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef __RISCV_BOUNDARY_SCAN_H__
+#define __RISCV_BOUNDARY_SCAN_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// Finding where instructions start in a stream mixing 16-bit and 32-bit
+// instructions is a serial problem : a 16-bit parcel starts an instruction
+// only if the previous instruction ended right before it. But whether a parcel
+// *would* start a 32-bit instruction only depends on its own 2 low bits, so
+// that can be computed for many parcels at once with SIMD compares, and the
+// starts then follow from those bits with a few 64-bit operations per 64
+// parcels, see instruction_continuations()
+
+#define PARCELS_PER_SCAN_BLOCK 64
+
+static inline uint16_t load_parcel(const uint8_t *buf, size_t i) {
+  return buf[2 * i] | (buf[2 * i + 1] << 8);
+}
+
+// Sets bit i of *longs if parcel i has its 2 low bits set (a 32-bit or longer
+// instruction if it starts one), and bit i of *too_longs if it has its 5 low
+// bits set (a 48-bit or longer instruction), for n <= 64 parcels of buf
+static inline void classify_parcels_scalar(const uint8_t *buf, size_t n,
+                                           uint64_t *longs,
+                                           uint64_t *too_longs) {
+  uint64_t l = 0;
+  uint64_t tl = 0;
+  for (size_t i = 0; i < n; i++) {
+    uint16_t p = load_parcel(buf, i);
+    l |= (uint64_t)((p & 0x3) == 0x3) << i;
+    tl |= (uint64_t)((p & 0x1F) == 0x1F) << i;
+  }
+  *longs = l;
+  *too_longs = tl;
+}
+
+#if defined(__AVX2__)
+// 32 parcels at a time
+static inline void classify_parcels_64(const uint8_t *buf, uint64_t *longs,
+                                       uint64_t *too_longs) {
+  const __m256i low2 = _mm256_set1_epi16(0x3);
+  const __m256i low5 = _mm256_set1_epi16(0x1F);
+  uint64_t l = 0;
+  uint64_t tl = 0;
+  for (int half = 0; half < 2; half++) {
+    const uint8_t *p = buf + half * 64;
+    __m256i a = _mm256_loadu_si256((const __m256i *)p);
+    __m256i b = _mm256_loadu_si256((const __m256i *)(p + 32));
+    // packs interleaves the 128-bit lanes of a and b, the permute puts the
+    // parcels back in order
+    __m256i la = _mm256_cmpeq_epi16(_mm256_and_si256(a, low2), low2);
+    __m256i lb = _mm256_cmpeq_epi16(_mm256_and_si256(b, low2), low2);
+    __m256i lab = _mm256_permute4x64_epi64(_mm256_packs_epi16(la, lb), 0xD8);
+    __m256i ta = _mm256_cmpeq_epi16(_mm256_and_si256(a, low5), low5);
+    __m256i tb = _mm256_cmpeq_epi16(_mm256_and_si256(b, low5), low5);
+    __m256i tab = _mm256_permute4x64_epi64(_mm256_packs_epi16(ta, tb), 0xD8);
+    l |= (uint64_t)(uint32_t)_mm256_movemask_epi8(lab) << (half * 32);
+    tl |= (uint64_t)(uint32_t)_mm256_movemask_epi8(tab) << (half * 32);
+  }
+  *longs = l;
+  *too_longs = tl;
+}
+#elif defined(__SSE2__) || defined(_M_X64)
+// 16 parcels at a time
+static inline void classify_parcels_64(const uint8_t *buf, uint64_t *longs,
+                                       uint64_t *too_longs) {
+  const __m128i low2 = _mm_set1_epi16(0x3);
+  const __m128i low5 = _mm_set1_epi16(0x1F);
+  uint64_t l = 0;
+  uint64_t tl = 0;
+  for (int quarter = 0; quarter < 4; quarter++) {
+    const uint8_t *p = buf + quarter * 32;
+    __m128i a = _mm_loadu_si128((const __m128i *)p);
+    __m128i b = _mm_loadu_si128((const __m128i *)(p + 16));
+    __m128i la = _mm_cmpeq_epi16(_mm_and_si128(a, low2), low2);
+    __m128i lb = _mm_cmpeq_epi16(_mm_and_si128(b, low2), low2);
+    __m128i ta = _mm_cmpeq_epi16(_mm_and_si128(a, low5), low5);
+    __m128i tb = _mm_cmpeq_epi16(_mm_and_si128(b, low5), low5);
+    l |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_packs_epi16(la, lb))
+         << (quarter * 16);
+    tl |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_packs_epi16(ta, tb))
+          << (quarter * 16);
+  }
+  *longs = l;
+  *too_longs = tl;
+}
+#else
+static inline void classify_parcels_64(const uint8_t *buf, uint64_t *longs,
+                                       uint64_t *too_longs) {
+  classify_parcels_scalar(buf, PARCELS_PER_SCAN_BLOCK, longs, too_longs);
+}
+#endif
+
+// Given the long parcels of a block, returns the parcels that are the second
+// half of a 32-bit instruction rather than the start of an instruction
+//
+// Every maximal run of long parcels begins at an instruction start, since the
+// parcel before it is either a 16-bit instruction or the end of a 32-bit one.
+// Within a run, starts and continuations then alternate, and the parcel right
+// after the run is a continuation iff the run has an odd length. This is the
+// same problem as finding the characters escaped by runs of backslashes, and
+// is solved the same way : adding the odd-aligned run starts to the runs
+// makes the carries flip the parity of the runs starting at odd positions.
+// *carry is 1 if the first parcel of the block continues the last instruction
+// of the previous block, and is updated for the next block
+static inline uint64_t instruction_continuations(uint64_t longs,
+                                                 uint64_t *carry) {
+  const uint64_t even_bits = 0x5555555555555555ULL;
+  longs &= ~*carry;
+  uint64_t follows_long = (longs << 1) | *carry;
+  uint64_t odd_run_starts = longs & ~even_bits & ~follows_long;
+  uint64_t runs_starting_on_even_bits = odd_run_starts + longs;
+  *carry = runs_starting_on_even_bits < longs;
+  uint64_t invert_mask = runs_starting_on_even_bits << 1;
+  return (even_bits ^ invert_mask) & follows_long;
+}
+
+static inline int lowest_set_bit(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctzll(x);
+#else
+  int i = 0;
+  while (!(x & 1)) {
+    x >>= 1;
+    i++;
+  }
+  return i;
+#endif
+}
+
+// Finds the instructions laid out back to back in the first nparcels 16-bit
+// parcels of buf, the first parcel being an instruction start. Sets bit i % 64
+// of starts[i / 64] iff an instruction starts at parcel i, stores the length
+// in bytes of the k-th instruction into lengths[k], and returns the number of
+// instructions found. starts must hold (nparcels + 63) / 64 words and lengths
+// nparcels bytes
+//
+// Stops before an instruction of 48 bits or longer, which no decoder handles,
+// and before a 32-bit instruction whose second half isn't in buf
+static inline size_t scan_instruction_boundaries(const uint8_t *buf,
+                                                 size_t nparcels,
+                                                 uint64_t *starts,
+                                                 uint8_t *lengths) {
+  size_t n = 0;
+  uint64_t carry = 0;
+  for (size_t block = 0; block * PARCELS_PER_SCAN_BLOCK < nparcels; block++) {
+    size_t first = block * PARCELS_PER_SCAN_BLOCK;
+    size_t count = nparcels - first < PARCELS_PER_SCAN_BLOCK
+                       ? nparcels - first
+                       : PARCELS_PER_SCAN_BLOCK;
+    uint64_t valid = count == 64 ? ~0ULL : (1ULL << count) - 1;
+    uint64_t longs;
+    uint64_t too_longs;
+    if (count == PARCELS_PER_SCAN_BLOCK) {
+      classify_parcels_64(buf + 2 * first, &longs, &too_longs);
+    } else {
+      classify_parcels_scalar(buf + 2 * first, count, &longs, &too_longs);
+    }
+    uint64_t block_starts = ~instruction_continuations(longs, &carry) & valid;
+    int stop = 0;
+    if (block_starts & too_longs) {
+      uint64_t first_too_long = block_starts & too_longs;
+      block_starts &= (first_too_long & -first_too_long) - 1;
+      stop = 1;
+    }
+    // a 32-bit instruction starting at the very last parcel is cut off
+    if (first + count == nparcels && (block_starts & longs) >> (count - 1)) {
+      block_starts &= ~(1ULL << (count - 1));
+      stop = 1;
+    }
+    starts[block] = block_starts;
+    for (uint64_t s = block_starts; s; s &= s - 1) {
+      lengths[n++] = (longs >> lowest_set_bit(s)) & 1 ? 4 : 2;
+    }
+    if (stop) {
+      for (size_t rest = block + 1;
+           rest * PARCELS_PER_SCAN_BLOCK < nparcels; rest++) {
+        starts[rest] = 0;
+      }
+      break;
+    }
+  }
+  return n;
+}
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef __RISCV_CONTROL_FLOW_H__
+#define __RISCV_CONTROL_FLOW_H__
+
+#include <stdint.h>
+
+#include "RISCVControlFlow.gen.inc"
+
+// Recognises only the instructions transferring control, for sweeps that
+// recover functions and basic blocks out of an image. decode_control_flow()
+// and decode_compressed_control_flow() (generated with -control-flow) build
+// the ast of those instructions exactly like decode() and decode_compressed()
+// do, and reject every other input, mostly with a single table lookup on its
+// opcode bits
+
+typedef struct RVControlFlowInsn {
+  struct ast tree;
+  uint8_t length;
+  // whether target holds the destination, only the pc-relative jumps and
+  // branches have one
+  uint8_t has_target;
+  uint64_t target;
+} RVControlFlowInsn;
+
+static inline int64_t sign_extend_bits(uint64_t v, int bits) {
+  uint64_t sign = 1ULL << (bits - 1);
+  return (int64_t)((v ^ sign) - sign);
+}
+
+// The jumps and branches hold their offset in bytes, except the compressed ones
+// which leave out its always zero low bit
+static inline uint8_t control_flow_target(const struct ast *tree, uint64_t pc,
+                                          uint64_t *target) {
+  uint64_t offset;
+  int bits;
+  switch (tree->ast_node_type) {
+  case RISCV_JAL:
+    offset = tree->ast_node.riscv_jal.imm;
+    bits = 21;
+    break;
+  case RISCV_BTYPE:
+    offset = tree->ast_node.btype.imm;
+    bits = 13;
+    break;
+  case RISCV_C_J:
+    offset = (uint64_t)tree->ast_node.c_j << 1;
+    bits = 12;
+    break;
+  case RISCV_C_JAL:
+    offset = (uint64_t)tree->ast_node.c_jal << 1;
+    bits = 12;
+    break;
+  case RISCV_C_BEQZ:
+    offset = (uint64_t)tree->ast_node.c_beqz.imm << 1;
+    bits = 9;
+    break;
+  case RISCV_C_BNEZ:
+    offset = (uint64_t)tree->ast_node.c_bnez.imm << 1;
+    bits = 9;
+    break;
+  default:
+    return 0;
+  }
+  *target = pc + sign_extend_bits(offset, bits);
+  return 1;
+}
+
+// Decodes the instruction in the low bits of word, found at address pc, into
+// out if it is a control transfer and returns 1, returns 0 for anything else
+static inline uint8_t decode_control_flow_insn(uint32_t word, uint64_t pc,
+                                               RVContext *ctx,
+                                               RVControlFlowInsn *out) {
+  if ((word & 0x3) != 0x3) {
+    out->length = 2;
+    if (!decode_compressed_control_flow(&out->tree, word & 0xFFFF, ctx)) {
+      return 0;
+    }
+  } else {
+    out->length = 4;
+    if (!decode_control_flow(&out->tree, word, ctx)) {
+      return 0;
+    }
+  }
+  out->has_target = control_flow_target(&out->tree, pc, &out->target);
+  if (out->has_target && ctx->xlen == 32) {
+    out->target &= 0xFFFFFFFF;
+  }
+  return 1;
+}
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef __RISCV_DECODE_BLOCK_H__
+#define __RISCV_DECODE_BLOCK_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "RISCVBoundaryScan.h"
+#include "RISCVDecode.gen.inc"
+#include "RISCVDecodeCompressed.gen.inc"
+
+// The length in bytes of the instruction starting with the 16-bit parcel p,
+// from its low bits as laid out by the base ISA's length encoding scheme.
+// Returns 0 for the 48-bit and longer formats, no decoder handles those
+static inline uint8_t instruction_length(uint16_t p) {
+  if ((p & 0x3) != 0x3) {
+    return 2;
+  }
+  if ((p & 0x1C) != 0x1C) {
+    return 4;
+  }
+  return 0;
+}
+
+// Walks the instructions laid out back to back in a buffer, finding where they
+// start a block of parcels at a time with scan_instruction_boundaries() rather
+// than from the length of each instruction in turn
+typedef struct RVBlockCursor {
+  const uint8_t *buf;
+  size_t len;
+  // where the next instruction starts
+  size_t offset;
+  // the lengths of the instructions of the last block scanned, the next
+  // instruction being the next-th one
+  uint8_t lengths[PARCELS_PER_SCAN_BLOCK];
+  size_t count;
+  size_t next;
+} RVBlockCursor;
+
+static inline void block_cursor_init(RVBlockCursor *cursor, const uint8_t *buf,
+                                     size_t len) {
+  cursor->buf = buf;
+  cursor->len = len;
+  cursor->offset = 0;
+  cursor->count = 0;
+  cursor->next = 0;
+}
+
+// Decodes the next instruction of the cursor into tree and moves past it.
+// Returns its length in bytes, or 0 without decoding anything if it isn't
+// entirely contained in the buffer or is longer than 32 bits
+static inline uint8_t decode_block_step(RVBlockCursor *cursor,
+                                        struct ast *tree, RVContext *ctx) {
+  if (cursor->next == cursor->count) {
+    size_t nparcels = (cursor->len - cursor->offset) / 2;
+    if (nparcels > PARCELS_PER_SCAN_BLOCK) {
+      nparcels = PARCELS_PER_SCAN_BLOCK;
+    }
+    uint64_t starts;
+    cursor->count = scan_instruction_boundaries(
+        cursor->buf + cursor->offset, nparcels, &starts, cursor->lengths);
+    cursor->next = 0;
+    if (cursor->count == 0) {
+      return 0;
+    }
+  }
+  const uint8_t *p = cursor->buf + cursor->offset;
+  uint8_t insn_len = cursor->lengths[cursor->next];
+  if (insn_len == 2) {
+    decode_compressed(tree, p[0] | (p[1] << 8), ctx);
+  } else {
+    uint64_t binary_stream = p[0] | (p[1] << 8) | ((uint64_t)p[2] << 16) |
+                             ((uint64_t)p[3] << 24);
+    decode(tree, binary_stream, ctx);
+  }
+  cursor->offset += insn_len;
+  cursor->next++;
+  return insn_len;
+}
+
+// Decodes the instructions laid out back to back in buf, a little-endian
+// stream of len bytes mixing 16-bit and 32-bit instructions, into
+// out[0..max-1], storing the length in bytes of each into lengths[]
+//
+// Stops after max instructions, before an instruction that isn't entirely
+// contained in buf, or before one longer than 32 bits. *decoded receives the
+// number of instructions decoded, and the number of bytes they span is
+// returned, so that the caller can resume from there
+static inline size_t decode_block(const uint8_t *buf, size_t len,
+                                  struct ast *out, uint8_t *lengths, size_t max,
+                                  size_t *decoded, RVContext *ctx) {
+  RVBlockCursor cursor;
+  block_cursor_init(&cursor, buf, len);
+  size_t n = 0;
+  uint8_t insn_len;
+  while (n < max && (insn_len = decode_block_step(&cursor, &out[n], ctx))) {
+    lengths[n] = insn_len;
+    n++;
+  }
+  *decoded = n;
+  return cursor.offset;
+}
+
+#endif
@@ -0,0 +1,210 @@
+#ifndef __RISCV_DECODE_CACHE_H__
+#define __RISCV_DECODE_CACHE_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#include "RISCVDecode.gen.inc"
+#include "RISCVDecodeCompressed.gen.inc"
+
+// A set-associative cache of decoding results, keyed by the encoding of the
+// instruction, the context it was decoded in and the generation of that
+// context (see updateEnabledExtensions()), so that re-decoding the same words,
+// e.g. a hot loop or a page disassembled again, is a lookup instead of a walk
+// through the decoder. Generations are counted per context : empty the cache
+// before a context is freed and another one may take its address
+//
+// Before including this header, define
+//   - RISCV_DECODE_CACHE_INSN_TYPE to also cache get_insn_type(), which must
+//     already be declared (RISCVInsnMappings.gen.inc)
+//   - RISCV_DECODE_CACHE_OPERANDS to also cache the output of fill_operands(),
+//     which must already be declared (RISCVOperands.gen.inc)
+//   - RISCV_DECODE_CACHE_SETS (a power of 2) and RISCV_DECODE_CACHE_WAYS to
+//     change the geometry, 1 way makes it direct-mapped
+//
+// RVDecodeCache is for a single thread and takes no locks. RVSharedDecodeCache
+// can be used by several threads at once, readers never write to it and only
+// retry-free seqlock checks guard the entries, a lookup that races with an
+// insertion into the same set simply decodes the instruction itself
+
+#ifndef RISCV_DECODE_CACHE_SETS
+#define RISCV_DECODE_CACHE_SETS 1024
+#endif
+
+#ifndef RISCV_DECODE_CACHE_WAYS
+#define RISCV_DECODE_CACHE_WAYS 2
+#endif
+
+#ifndef RISCV_DECODE_CACHE_MAX_OPS
+#define RISCV_DECODE_CACHE_MAX_OPS 8
+#endif
+
+typedef struct RVDecodedInsn {
+  struct ast tree;
+#ifdef RISCV_DECODE_CACHE_INSN_TYPE
+  uint16_t insn_type;
+#endif
+#ifdef RISCV_DECODE_CACHE_OPERANDS
+  cs_riscv_op ops[RISCV_DECODE_CACHE_MAX_OPS];
+  uint8_t op_count;
+#endif
+} RVDecodedInsn;
+
+typedef struct RVDecodeCacheStats {
+  uint64_t hits;
+  uint64_t misses;
+} RVDecodeCacheStats;
+
+typedef struct RVDecodeCacheEntry {
+  uint64_t encoding;
+  // NULL for an empty entry
+  const RVContext *ctx;
+  uint64_t generation;
+  RVDecodedInsn insn;
+} RVDecodeCacheEntry;
+
+// Only keeps the bits of the instruction starting in the low bits of
+// binary_stream, whose 2 low bits tell its length. Compressed encodings never
+// have both set, so they can't collide with 32-bit ones
+static inline uint64_t rv_instruction_encoding(uint64_t binary_stream) {
+  if ((binary_stream & 0x3) != 0x3) {
+    return binary_stream & 0xFFFF;
+  }
+  return binary_stream & 0xFFFFFFFF;
+}
+
+static inline size_t decode_cache_set_index(uint64_t encoding) {
+  return ((encoding * 0x9E3779B97F4A7C15ULL) >> 32) &
+         (RISCV_DECODE_CACHE_SETS - 1);
+}
+
+// Zeroes out first so that entries never carry over bytes of the previous
+// instruction, in the members of the ast that this one doesn't use
+static inline void rv_decode_insn(RVDecodedInsn *out, uint64_t encoding,
+                                  RVContext *ctx) {
+  memset(out, 0, sizeof(*out));
+  if ((encoding & 0x3) != 0x3) {
+    decode_compressed(&out->tree, encoding, ctx);
+  } else {
+    decode(&out->tree, encoding, ctx);
+  }
+#ifdef RISCV_DECODE_CACHE_INSN_TYPE
+  out->insn_type = get_insn_type(&out->tree);
+#endif
+#ifdef RISCV_DECODE_CACHE_OPERANDS
+  fill_operands(&out->tree, out->ops, &out->op_count);
+#endif
+}
+
+typedef struct RVDecodeCache {
+  RVDecodeCacheEntry entries[RISCV_DECODE_CACHE_SETS][RISCV_DECODE_CACHE_WAYS];
+  uint8_t next_victim[RISCV_DECODE_CACHE_SETS];
+  RVDecodeCacheStats stats;
+} RVDecodeCache;
+
+// The cache must be zeroed before its first use, and can be zeroed again at
+// any time to empty it
+static inline void decode_cache_init(RVDecodeCache *cache) {
+  memset(cache, 0, sizeof(*cache));
+}
+
+// Returns the decoding of the instruction in the low bits of binary_stream,
+// valid until the next call with the same cache. A context that was never
+// passed to updateEnabledExtensions() may change without its generation
+// telling, its instructions are decoded every time and never cached
+static inline const RVDecodedInsn *decode_cached(RVDecodeCache *cache,
+                                                 uint64_t binary_stream,
+                                                 RVContext *ctx) {
+  uint64_t encoding = rv_instruction_encoding(binary_stream);
+  uint64_t generation = ctx->generation;
+  size_t set = decode_cache_set_index(encoding);
+  RVDecodeCacheEntry *ways = cache->entries[set];
+  for (int w = 0; w < RISCV_DECODE_CACHE_WAYS && generation != 0; w++) {
+    if (ways[w].ctx == ctx && ways[w].generation == generation &&
+        ways[w].encoding == encoding) {
+      cache->stats.hits++;
+      return &ways[w].insn;
+    }
+  }
+  cache->stats.misses++;
+  RVDecodeCacheEntry *victim = &ways[cache->next_victim[set]];
+  cache->next_victim[set] =
+      (cache->next_victim[set] + 1) % RISCV_DECODE_CACHE_WAYS;
+  rv_decode_insn(&victim->insn, encoding, ctx);
+  victim->encoding = encoding;
+  victim->ctx = generation != 0 ? ctx : NULL;
+  victim->generation = generation;
+  return &victim->insn;
+}
+
+#ifdef RISCV_HAVE_C11_ATOMICS
+
+typedef struct RVSharedDecodeCacheSet {
+  // odd while an insertion into the set is in progress
+  atomic_uint seq;
+  uint8_t next_victim;
+  RVDecodeCacheEntry ways[RISCV_DECODE_CACHE_WAYS];
+} RVSharedDecodeCacheSet;
+
+typedef struct RVSharedDecodeCache {
+  RVSharedDecodeCacheSet sets[RISCV_DECODE_CACHE_SETS];
+} RVSharedDecodeCache;
+
+static inline void shared_decode_cache_init(RVSharedDecodeCache *cache) {
+  memset(cache, 0, sizeof(*cache));
+}
+
+// Copies the decoding of the instruction in the low bits of binary_stream
+// into out. The hit and miss counters are in stats rather than in the cache
+// so that threads don't contend on them, give each thread its own. As with
+// decode_cached(), a context of generation 0 is never cached
+static inline void decode_cached_shared(RVSharedDecodeCache *cache,
+                                        RVDecodedInsn *out,
+                                        uint64_t binary_stream, RVContext *ctx,
+                                        RVDecodeCacheStats *stats) {
+  uint64_t encoding = rv_instruction_encoding(binary_stream);
+  uint64_t generation = ctx->generation;
+  if (generation == 0) {
+    stats->misses++;
+    rv_decode_insn(out, encoding, ctx);
+    return;
+  }
+  RVSharedDecodeCacheSet *set =
+      &cache->sets[decode_cache_set_index(encoding)];
+  unsigned seq = atomic_load_explicit(&set->seq, memory_order_acquire);
+  if (!(seq & 1)) {
+    for (int w = 0; w < RISCV_DECODE_CACHE_WAYS; w++) {
+      if (set->ways[w].ctx == ctx && set->ways[w].generation == generation &&
+          set->ways[w].encoding == encoding) {
+        memcpy(out, &set->ways[w].insn, sizeof(*out));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&set->seq, memory_order_relaxed) == seq) {
+          stats->hits++;
+          return;
+        }
+        break;
+      }
+    }
+  }
+  stats->misses++;
+  rv_decode_insn(out, encoding, ctx);
+  // Only insert if no other thread touched the set since it was read, rather
+  // than wait for it
+  if (!(seq & 1) &&
+      atomic_compare_exchange_strong_explicit(&set->seq, &seq, seq + 1,
+                                              memory_order_relaxed,
+                                              memory_order_relaxed)) {
+    atomic_thread_fence(memory_order_release);
+    RVDecodeCacheEntry *victim = &set->ways[set->next_victim];
+    set->next_victim = (set->next_victim + 1) % RISCV_DECODE_CACHE_WAYS;
+    victim->encoding = encoding;
+    victim->ctx = ctx;
+    victim->generation = generation;
+    memcpy(&victim->insn, out, sizeof(*out));
+    atomic_store_explicit(&set->seq, seq + 2, memory_order_release);
+  }
+}
+
+#endif
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef __RISCV_DECODE_COLUMNS_H__
+#define __RISCV_DECODE_COLUMNS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "RISCVDecodeBlock.h"
+#include "RISCVInsnMappings.gen.inc"
+#include "RISCVOperands.gen.inc"
+
+// Batch decoding into parallel arrays rather than an array of struct ast, for
+// passes over many instructions that only look at a few of their properties
+// (e.g. which registers each one defines and uses) : the k-th instruction is
+// described by the k-th element of every array. RISCVOperands.gen.inc must be
+// generated with -operand-columns, see fill_operand_roles() for what the
+// register and immediate columns hold. A register column holds 0 where the
+// instruction has no register in that role
+//
+// The caller allocates every array with room for as many instructions as it
+// asks for
+typedef struct RVDecodedColumns {
+  uint16_t *case_ids; // the ast_node_type of the instruction
+  uint16_t *insn_ids; // get_insn_type()
+  uint8_t *lengths;   // in bytes
+  uint8_t *rd;
+  uint8_t *rs1;
+  uint8_t *rs2;
+  uint8_t *rs3;
+  uint64_t *imm;
+} RVDecodedColumns;
+
+// Same contract as decode_block(), writing into the columns instead
+static inline size_t decode_block_columns(const uint8_t *buf, size_t len,
+                                          RVDecodedColumns *cols, size_t max,
+                                          size_t *decoded, RVContext *ctx) {
+  RVBlockCursor cursor;
+  block_cursor_init(&cursor, buf, len);
+  size_t n = 0;
+  struct ast tree;
+  uint8_t insn_len;
+  while (n < max && (insn_len = decode_block_step(&cursor, &tree, ctx))) {
+    uint8_t regs[RISCV_OPERAND_ROLES];
+    fill_operand_roles(&tree, regs, &cols->imm[n]);
+    cols->case_ids[n] = tree.ast_node_type;
+    cols->insn_ids[n] = get_insn_type(&tree);
+    cols->lengths[n] = insn_len;
+    cols->rd[n] = regs[0];
+    cols->rs1[n] = regs[1];
+    cols->rs2[n] = regs[2];
+    cols->rs3[n] = regs[3];
+    n++;
+  }
+  *decoded = n;
+  return cursor.offset;
+}
+
+#endif
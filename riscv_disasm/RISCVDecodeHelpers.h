@@ -4,9 +4,20 @@
 #include "RISCVRVContextHelpers.h"
 
 #include <stdio.h>
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L &&               \
+    !defined(__STDC_NO_ATOMICS__)
+#define RISCV_HAVE_C11_ATOMICS
+#include <stdatomic.h>
+#endif
 
 #include "RISCVAst.gen.inc"
 
+// Reports the invalid inputs the helpers below run into, define it before
+// including the decoders to count or silence these messages
+#ifndef RISCV_HELPER_ERROR
+#define RISCV_HELPER_ERROR(...) printf(__VA_ARGS__)
+#endif
+
 typedef enum ExtensionType {
   // Integer Multiplication and Division; not Machine!
   RISCV_Ext_M = 1ULL << 0,
@@ -127,27 +138,30 @@ typedef enum ExtensionType {
 
 #define HART_SUPPORTS(e) (ctx->extensionsSupported & RISCV_##e)
 
-static inline bool currentlyEnabled(ExtensionType t, RVContext *ctx) {
+// Follows the currentlyEnabled() function clauses of the Sail model, this reads
+// the CSRs of the context on every call so it's only used to (re)compute the
+// enabledExtensions mask, see updateEnabledExtensions()
+static inline bool resolveCurrentlyEnabled(ExtensionType t, RVContext *ctx) {
   switch (t) {
   case RISCV_Ext_M:
-    return HART_SUPPORTS(Ext_M) && MISA(M) == 1;
+    return HART_SUPPORTS(Ext_M) && MISA(M) != 0;
   case RISCV_Ext_A:
-    return HART_SUPPORTS(Ext_A) && MISA(A) == 1;
+    return HART_SUPPORTS(Ext_A) && MISA(A) != 0;
   case RISCV_Ext_F:
-    return HART_SUPPORTS(Ext_F) && MISA(F) == 1 && MSTATUS(FS) != 0;
+    return HART_SUPPORTS(Ext_F) && MISA(F) != 0 && MSTATUS(FS) != 0;
   case RISCV_Ext_D:
-    return HART_SUPPORTS(Ext_D) && MISA(D) == 1 && MSTATUS(FS) != 0 &&
+    return HART_SUPPORTS(Ext_D) && MISA(D) != 0 && MSTATUS(FS) != 0 &&
            ctx->flen >= 64;
   case RISCV_Ext_C:
-    return HART_SUPPORTS(Ext_C) && MISA(C) == 1;
+    return HART_SUPPORTS(Ext_C) && MISA(C) != 0;
   case RISCV_Ext_B:
-    return HART_SUPPORTS(Ext_B) && MISA(B) == 1;
+    return HART_SUPPORTS(Ext_B) && MISA(B) != 0;
   case RISCV_Ext_V:
-    return HART_SUPPORTS(Ext_V) && MISA(V) == 1 && MSTATUS(VS) != 0;
+    return HART_SUPPORTS(Ext_V) && MISA(V) != 0 && MSTATUS(VS) != 0;
   case RISCV_Ext_S:
-    return HART_SUPPORTS(Ext_S) && MISA(S) == 1;
+    return HART_SUPPORTS(Ext_S) && MISA(S) != 0;
   case RISCV_Ext_U:
-    return HART_SUPPORTS(Ext_U) && MISA(U) == 1;
+    return HART_SUPPORTS(Ext_U) && MISA(U) != 0;
   case RISCV_Ext_Zicbom:
     return HART_SUPPORTS(Ext_Zicbom);
   case RISCV_Ext_Zicboz:
@@ -159,25 +173,31 @@ static inline bool currentlyEnabled(ExtensionType t, RVContext *ctx) {
   case RISCV_Ext_Zifencei:
     return HART_SUPPORTS(Ext_Zifencei);
   case RISCV_Ext_Zihpm:
-    return HART_SUPPORTS(Ext_Zihpm) && currentlyEnabled(RISCV_Ext_Zicntr, ctx);
+    return HART_SUPPORTS(Ext_Zihpm) &&
+           resolveCurrentlyEnabled(RISCV_Ext_Zicntr, ctx);
   case RISCV_Ext_Zimop:
     return HART_SUPPORTS(Ext_Zimop);
   case RISCV_Ext_Zmmul:
-    return HART_SUPPORTS(Ext_Zmmul) || currentlyEnabled(RISCV_Ext_M, ctx);
+    return HART_SUPPORTS(Ext_Zmmul) ||
+           resolveCurrentlyEnabled(RISCV_Ext_M, ctx);
   case RISCV_Ext_Zaamo:
-    return HART_SUPPORTS(Ext_Zaamo) || currentlyEnabled(RISCV_Ext_A, ctx);
+    return HART_SUPPORTS(Ext_Zaamo) ||
+           resolveCurrentlyEnabled(RISCV_Ext_A, ctx);
 
   case RISCV_Ext_Zabha:
-    return HART_SUPPORTS(Ext_Zabha) && currentlyEnabled(RISCV_Ext_Zaamo, ctx);
+    return HART_SUPPORTS(Ext_Zabha) &&
+           resolveCurrentlyEnabled(RISCV_Ext_Zaamo, ctx);
   case RISCV_Ext_Zalrsc:
-    return HART_SUPPORTS(Ext_Zalrsc) || currentlyEnabled(RISCV_Ext_A, ctx);
+    return HART_SUPPORTS(Ext_Zalrsc) ||
+           resolveCurrentlyEnabled(RISCV_Ext_A, ctx);
   case RISCV_Ext_Zfa:
-    return HART_SUPPORTS(Ext_Zfa) && currentlyEnabled(RISCV_Ext_F, ctx);
+    return HART_SUPPORTS(Ext_Zfa) && resolveCurrentlyEnabled(RISCV_Ext_F, ctx);
   case RISCV_Ext_Zfh:
-    return HART_SUPPORTS(Ext_Zfh) && currentlyEnabled(RISCV_Ext_F, ctx);
+    return HART_SUPPORTS(Ext_Zfh) && resolveCurrentlyEnabled(RISCV_Ext_F, ctx);
   case RISCV_Ext_Zfhmin:
-    return (HART_SUPPORTS(Ext_Zfhmin) && currentlyEnabled(RISCV_Ext_F, ctx)) ||
-           currentlyEnabled(RISCV_Ext_Zfh, ctx);
+    return (HART_SUPPORTS(Ext_Zfhmin) &&
+            resolveCurrentlyEnabled(RISCV_Ext_F, ctx)) ||
+           resolveCurrentlyEnabled(RISCV_Ext_Zfh, ctx);
   // function clause currentlyEnabled(Ext_Zfinx) = sys_enable_zfinx()
   case RISCV_Ext_Zfinx:
     return HART_SUPPORTS(Ext_Zfinx);
@@ -185,23 +205,30 @@ static inline bool currentlyEnabled(ExtensionType t, RVContext *ctx) {
     return HART_SUPPORTS(Ext_Zdinx) && ctx->flen >= 64;
   case RISCV_Ext_Zca:
     return HART_SUPPORTS(Ext_Zca) &&
-           (currentlyEnabled(RISCV_Ext_C, ctx) || !HART_SUPPORTS(Ext_C));
+           (resolveCurrentlyEnabled(RISCV_Ext_C, ctx) ||
+            !HART_SUPPORTS(Ext_C));
   case RISCV_Ext_Zcb:
-    return HART_SUPPORTS(Ext_Zcb) && currentlyEnabled(RISCV_Ext_Zca, ctx);
+    return HART_SUPPORTS(Ext_Zcb) &&
+           resolveCurrentlyEnabled(RISCV_Ext_Zca, ctx);
   case RISCV_Ext_Zcd:
-    return HART_SUPPORTS(Ext_Zcd) && currentlyEnabled(RISCV_Ext_Zca, ctx) &&
-           currentlyEnabled(RISCV_Ext_D, ctx) &&
-           (currentlyEnabled(RISCV_Ext_C, ctx) || !HART_SUPPORTS(Ext_C));
+    return HART_SUPPORTS(Ext_Zcd) &&
+           resolveCurrentlyEnabled(RISCV_Ext_Zca, ctx) &&
+           resolveCurrentlyEnabled(RISCV_Ext_D, ctx) &&
+           (resolveCurrentlyEnabled(RISCV_Ext_C, ctx) ||
+            !HART_SUPPORTS(Ext_C));
   case RISCV_Ext_Zcf:
-    return HART_SUPPORTS(Ext_Zcf) && currentlyEnabled(RISCV_Ext_Zca, ctx) &&
-           currentlyEnabled(RISCV_Ext_F, ctx) &&
-           (currentlyEnabled(RISCV_Ext_C, ctx) || !HART_SUPPORTS(Ext_C));
+    return HART_SUPPORTS(Ext_Zcf) &&
+           resolveCurrentlyEnabled(RISCV_Ext_Zca, ctx) &&
+           resolveCurrentlyEnabled(RISCV_Ext_F, ctx) &&
+           (resolveCurrentlyEnabled(RISCV_Ext_C, ctx) ||
+            !HART_SUPPORTS(Ext_C));
   case RISCV_Ext_Zcmop:
-    return HART_SUPPORTS(Ext_Zcmop) && currentlyEnabled(RISCV_Ext_Zca, ctx);
+    return HART_SUPPORTS(Ext_Zcmop) &&
+           resolveCurrentlyEnabled(RISCV_Ext_Zca, ctx);
   case RISCV_Ext_Zba:
-    return HART_SUPPORTS(Ext_Zba) || currentlyEnabled(RISCV_Ext_B, ctx);
+    return HART_SUPPORTS(Ext_Zba) || resolveCurrentlyEnabled(RISCV_Ext_B, ctx);
   case RISCV_Ext_Zbb:
-    return HART_SUPPORTS(Ext_Zbb) || currentlyEnabled(RISCV_Ext_B, ctx);
+    return HART_SUPPORTS(Ext_Zbb) || resolveCurrentlyEnabled(RISCV_Ext_B, ctx);
   case RISCV_Ext_Zbc:
     return HART_SUPPORTS(Ext_Zbc);
   case RISCV_Ext_Zbkb:
@@ -211,7 +238,7 @@ static inline bool currentlyEnabled(ExtensionType t, RVContext *ctx) {
   case RISCV_Ext_Zbkx:
     return HART_SUPPORTS(Ext_Zbkx);
   case RISCV_Ext_Zbs:
-    return HART_SUPPORTS(Ext_Zbs) || currentlyEnabled(RISCV_Ext_B, ctx);
+    return HART_SUPPORTS(Ext_Zbs) || resolveCurrentlyEnabled(RISCV_Ext_B, ctx);
   case RISCV_Ext_Zknd:
     return HART_SUPPORTS(Ext_Zknd);
   case RISCV_Ext_Zkne:
@@ -225,22 +252,26 @@ static inline bool currentlyEnabled(ExtensionType t, RVContext *ctx) {
   case RISCV_Ext_Zksh:
     return HART_SUPPORTS(Ext_Zksh);
   case RISCV_Ext_Zhinx:
-    return HART_SUPPORTS(Ext_Zhinx) & currentlyEnabled(RISCV_Ext_Zfinx, ctx);
+    return HART_SUPPORTS(Ext_Zhinx) &
+           resolveCurrentlyEnabled(RISCV_Ext_Zfinx, ctx);
   case RISCV_Ext_Sstc:
     return HART_SUPPORTS(Ext_Sstc);
   case RISCV_Ext_Svinval:
     return HART_SUPPORTS(Ext_Svinval);
   case RISCV_Ext_Zvbb:
-    return HART_SUPPORTS(Ext_Zvbb) && currentlyEnabled(RISCV_Ext_V, ctx);
+    return HART_SUPPORTS(Ext_Zvbb) && resolveCurrentlyEnabled(RISCV_Ext_V, ctx);
   case RISCV_Ext_Zvkb:
-    return (HART_SUPPORTS(Ext_Zvkb) || currentlyEnabled(RISCV_Ext_Zvbb, ctx)) &&
-           currentlyEnabled(RISCV_Ext_V, ctx);
+    return (HART_SUPPORTS(Ext_Zvkb) ||
+            resolveCurrentlyEnabled(RISCV_Ext_Zvbb, ctx)) &&
+           resolveCurrentlyEnabled(RISCV_Ext_V, ctx);
   case RISCV_Ext_Zvbc:
-    return HART_SUPPORTS(Ext_Zvbc) && currentlyEnabled(RISCV_Ext_V, ctx);
+    return HART_SUPPORTS(Ext_Zvbc) && resolveCurrentlyEnabled(RISCV_Ext_V, ctx);
   case RISCV_Ext_Zvknhb:
-    return HART_SUPPORTS(Ext_Zvknhb) && currentlyEnabled(RISCV_Ext_V, ctx);
+    return HART_SUPPORTS(Ext_Zvknhb) &&
+           resolveCurrentlyEnabled(RISCV_Ext_V, ctx);
   case RISCV_Ext_Zvknha:
-    return HART_SUPPORTS(Ext_Zvknha) && currentlyEnabled(RISCV_Ext_V, ctx);
+    return HART_SUPPORTS(Ext_Zvknha) &&
+           resolveCurrentlyEnabled(RISCV_Ext_V, ctx);
   // Not supported in the model yet.
   // function clause currentlyEnabled(Ext_Svnapot) = false
   // function clause currentlyEnabled(Ext_Svpbmt) = false
@@ -249,17 +280,59 @@ static inline bool currentlyEnabled(ExtensionType t, RVContext *ctx) {
     return 0;
   case RISCV_Ext_Sscofpmf:
     return HART_SUPPORTS(Ext_Sscofpmf) &&
-           currentlyEnabled(RISCV_Ext_Zihpm, ctx);
+           resolveCurrentlyEnabled(RISCV_Ext_Zihpm, ctx);
   case RISCV_Ext_Smcntrpmf:
     return HART_SUPPORTS(Ext_Smcntrpmf) &&
-           currentlyEnabled(RISCV_Ext_Zicntr, ctx);
+           resolveCurrentlyEnabled(RISCV_Ext_Zicntr, ctx);
 
   default:
-    printf("currentlyEnabled: ERROR! Unknown extension.\n");
+    RISCV_HELPER_ERROR(
+        "resolveCurrentlyEnabled: ERROR! Unknown extension.\n");
     return 0;
   }
 }
 
+// Lets code built against older copies of these helpers too, like the bench
+// difftest, tell whether contexts have an extension mask to resolve
+#define RISCV_HAVE_ENABLED_EXTENSIONS_MASK
+
+// Must be called whenever xlen, flen, misa, mstatus or extensionsSupported
+// change, the decoders only ever consult the resulting mask. Caches of
+// decoding results also rely on it being called after any other change to the
+// context, such as vtype, which bumps its generation. A context that was never
+// passed to it (generation still 0) has its extensions resolved from its CSRs
+// on every check instead
+static inline void updateEnabledExtensions(RVContext *ctx) {
+  uint64_t enabled = 0;
+  for (uint64_t e = RISCV_Ext_M; e <= RISCV_Ext_Smcntrpmf; e <<= 1) {
+    if (resolveCurrentlyEnabled((ExtensionType)e, ctx)) {
+      enabled |= e;
+    }
+  }
+  ctx->enabledExtensions = enabled;
+  ctx->generation++;
+}
+
+// The extensions of exts enabled in ctx. Nothing is written to the context,
+// so one context can be shared between threads decoding with it
+static inline uint64_t enabledExtensionsAmong(uint64_t exts, RVContext *ctx) {
+  if (ctx->generation != 0) {
+    return ctx->enabledExtensions & exts;
+  }
+  uint64_t enabled = 0;
+  for (uint64_t rest = exts; rest != 0; rest &= rest - 1) {
+    uint64_t e = rest & (~rest + 1);
+    if (resolveCurrentlyEnabled((ExtensionType)e, ctx)) {
+      enabled |= e;
+    }
+  }
+  return enabled;
+}
+
+static inline bool currentlyEnabled(ExtensionType t, RVContext *ctx) {
+  return enabledExtensionsAmong(t, ctx) != 0;
+}
+
 static inline bool not(bool b, RVContext *ctx) { return !b; }
 
 static inline uint8_t size_bytes_forwards(enum word_width width,
@@ -274,7 +347,8 @@ static inline uint8_t size_bytes_forwards(enum word_width width,
   case RISCV_DOUBLE:
     return 8;
   default:
-    printf("size_bytes_forwards: ERROR! Unhandled word_width case");
+    RISCV_HELPER_ERROR(
+        "size_bytes_forwards: ERROR! Unhandled word_width case");
     return 0xFF;
   }
 }
@@ -305,22 +379,20 @@ static inline bool amo_width_valid(enum word_width width, RVContext *ctx) {
 }
 
 static inline bool haveDoubleFPU(RVContext *ctx) {
-  return currentlyEnabled(RISCV_Ext_D, ctx) ||
-         currentlyEnabled(RISCV_Ext_Zdinx, ctx);
+  return enabledExtensionsAmong(RISCV_Ext_D | RISCV_Ext_Zdinx, ctx) != 0;
 }
 
 static inline bool haveSingleFPU(RVContext *ctx) {
-  return currentlyEnabled(RISCV_Ext_F, ctx) ||
-         currentlyEnabled(RISCV_Ext_Zfinx, ctx);
+  return enabledExtensionsAmong(RISCV_Ext_F | RISCV_Ext_Zfinx, ctx) != 0;
 }
 
 static inline bool haveHalfFPU(RVContext *ctx) {
-  return currentlyEnabled(RISCV_Ext_Zfh, ctx) ||
-         currentlyEnabled(RISCV_Ext_Zhinx, ctx);
+  return enabledExtensionsAmong(RISCV_Ext_Zfh | RISCV_Ext_Zhinx, ctx) != 0;
 }
 
 static inline bool haveHalfMin(RVContext *ctx) {
-  return haveHalfFPU(ctx) || currentlyEnabled(RISCV_Ext_Zfhmin, ctx);
+  return enabledExtensionsAmong(
+             RISCV_Ext_Zfh | RISCV_Ext_Zhinx | RISCV_Ext_Zfhmin, ctx) != 0;
 }
 
 static inline bool in32BitMode(RVContext *ctx) { return ctx->xlen == 32; }
@@ -368,7 +440,7 @@ static inline uint32_t get_sew(RVContext *ctx) {
   case 6:
     return 1 << VTYPE(VSEW);
   default:
-    printf(
+    RISCV_HELPER_ERROR(
         "get_sew: ERROR!: Invalid vsew field of vector control register vtype");
     return 0;
   }
@@ -386,8 +458,8 @@ static inline int32_t get_lmul_pow(RVContext *ctx) {
   case 7:
     return VTYPE(VLMUL) - 8;
   default:
-    printf("get_lmul_pow: ERROR!: Invalid vsew field of vector control "
-           "register vtype");
+    RISCV_HELPER_ERROR("get_lmul_pow: ERROR!: Invalid vsew field of vector "
+                       "control register vtype");
     return 0;
   }
 }
@@ -404,7 +476,8 @@ static inline float get_lmul(int32_t lpow) {
   case -1:
     return 0.5;
   default:
-    printf("get_lmul: ERROR!: Invalid vsew field, unexpected value");
+    RISCV_HELPER_ERROR(
+        "get_lmul: ERROR!: Invalid vsew field, unexpected value");
   }
   // any number that appears strange and invalid
   return (float)(~0);
@@ -0,0 +1,172 @@
+#ifndef __RISCV_DECODE_STATS_H__
+#define __RISCV_DECODE_STATS_H__
+
+// Counters for decoders generated with -decode-stats. When RISCV_DECODE_STATS
+// is defined, every call to decode() or decode_compressed() counts the rules
+// whose conditions it evaluated and the guard helpers it called before
+// building an ast node, and adds them to the counters of that ast case. Inputs
+// that no rule matched are counted apart, those decoded as ILLEGAL or
+// C_ILLEGAL went through every rule before them. decode_stats_dump() prints
+// the counters, the cases that cost the most rules tried overall first
+//
+// Without RISCV_DECODE_STATS the macros expand to nothing, and the decoders
+// are the same as without -decode-stats. The counters are plain globals, they
+// are meant for profiling a single-threaded workload. They are shared by every
+// translation unit : exactly one of them defines them, by defining
+// RISCV_DEFINE_DECODE_STATS before including the decoders
+//
+// Decoders generated with -compressed-table also count the lookups of
+// decode_compressed_from_table() in the counters of decode_compressed, as a
+// single rule tried and no guard calls
+
+#ifdef RISCV_DECODE_STATS
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef RISCV_DECODE_STATS_MAX_CASES
+// more than the number of ast cases, larger ones are counted as not matched
+#define RISCV_DECODE_STATS_MAX_CASES 1024
+#endif
+
+typedef struct RVDecodeCaseStats {
+  // the name of the ast case, NULL until an input decodes to it
+  const char *name;
+  uint64_t matches;
+  uint64_t rules_tried;
+  uint64_t guard_calls;
+} RVDecodeCaseStats;
+
+typedef struct RVDecodeStats {
+  const char *proc_name;
+  uint64_t calls;
+  // inputs that no rule matched, and the rules tried on them
+  uint64_t no_match;
+  uint64_t no_match_rules_tried;
+  RVDecodeCaseStats cases[RISCV_DECODE_STATS_MAX_CASES];
+} RVDecodeStats;
+
+// The counts of the call in progress
+typedef struct RVDecodeStatsCall {
+  RVDecodeStats *stats;
+  uint32_t rules_tried;
+  uint32_t guard_calls;
+} RVDecodeStatsCall;
+
+extern RVDecodeStats decode_stats;
+extern RVDecodeStats decode_compressed_stats;
+
+#ifdef RISCV_DEFINE_DECODE_STATS
+RVDecodeStats decode_stats = {"decode"};
+RVDecodeStats decode_compressed_stats = {"decode_compressed"};
+#endif
+
+static inline void decode_stats_match(const RVDecodeStatsCall *call,
+                                      unsigned case_id, const char *name) {
+  if (case_id >= RISCV_DECODE_STATS_MAX_CASES) {
+    call->stats->no_match++;
+    call->stats->no_match_rules_tried += call->rules_tried;
+    return;
+  }
+  RVDecodeCaseStats *c = &call->stats->cases[case_id];
+  c->name = name;
+  c->matches++;
+  c->rules_tried += call->rules_tried;
+  c->guard_calls += call->guard_calls;
+}
+
+#define DECODE_STATS_BEGIN(proc)                                              \
+  RVDecodeStatsCall decode_stats_call = {&proc##_stats, 0, 0};                \
+  proc##_stats.calls++
+#define DECODE_STATS_RULE() decode_stats_call.rules_tried++
+#define DECODE_STATS_GUARD(call) (decode_stats_call.guard_calls++, (call))
+#define DECODE_STATS_MATCH(case_id)                                           \
+  decode_stats_match(&decode_stats_call, case_id, #case_id)
+#define DECODE_STATS_NO_MATCH()                                               \
+  do {                                                                        \
+    decode_stats_call.stats->no_match++;                                      \
+    decode_stats_call.stats->no_match_rules_tried +=                          \
+        decode_stats_call.rules_tried;                                        \
+  } while (0)
+
+static inline int decode_stats_by_rules_tried(const void *a,
+                                              const void *b) {
+  uint64_t ra = ((const RVDecodeCaseStats *)a)->rules_tried;
+  uint64_t rb = ((const RVDecodeCaseStats *)b)->rules_tried;
+  return (ra < rb) - (ra > rb);
+}
+
+static inline void decode_stats_dump_proc(FILE *out,
+                                          const RVDecodeStats *stats) {
+  static RVDecodeCaseStats sorted[RISCV_DECODE_STATS_MAX_CASES];
+  uint64_t total_rules = stats->no_match_rules_tried;
+  uint64_t total_guards = 0;
+  uint64_t illegal = 0;
+  size_t n = 0;
+  for (size_t i = 0; i < RISCV_DECODE_STATS_MAX_CASES; i++) {
+    const RVDecodeCaseStats *c = &stats->cases[i];
+    if (c->matches == 0) {
+      continue;
+    }
+    total_rules += c->rules_tried;
+    total_guards += c->guard_calls;
+    if (i == RISCV_ILLEGAL || i == RISCV_C_ILLEGAL) {
+      illegal += c->matches;
+    }
+    sorted[n++] = *c;
+  }
+  fprintf(out, "%s: %llu calls", stats->proc_name,
+          (unsigned long long)stats->calls);
+  if (stats->calls == 0) {
+    fprintf(out, "\n\n");
+    return;
+  }
+  fprintf(out,
+          ", %.1f rules tried and %.2f guard calls per call, %llu decoded as "
+          "illegal, %llu not matched by any rule\n",
+          (double)total_rules / stats->calls,
+          (double)total_guards / stats->calls, (unsigned long long)illegal,
+          (unsigned long long)stats->no_match);
+  qsort(sorted, n, sizeof(RVDecodeCaseStats), decode_stats_by_rules_tried);
+  fprintf(out, "%-32s %12s %10s %11s %8s\n", "case", "matches", "rules/call",
+          "guards/call", "% rules");
+  for (size_t i = 0; i < n; i++) {
+    const RVDecodeCaseStats *c = &sorted[i];
+    fprintf(out, "%-32s %12llu %10.1f %11.2f %8.2f\n", c->name,
+            (unsigned long long)c->matches,
+            (double)c->rules_tried / c->matches,
+            (double)c->guard_calls / c->matches,
+            total_rules ? 100.0 * c->rules_tried / total_rules : 0.0);
+  }
+  fprintf(out, "\n");
+}
+
+// Prints the counters of both decoders to out
+static inline void decode_stats_dump(FILE *out) {
+  decode_stats_dump_proc(out, &decode_stats);
+  decode_stats_dump_proc(out, &decode_compressed_stats);
+}
+
+static inline void decode_stats_reset(void) {
+  memset(decode_stats.cases, 0, sizeof(decode_stats.cases));
+  memset(decode_compressed_stats.cases, 0,
+         sizeof(decode_compressed_stats.cases));
+  decode_stats.calls = decode_stats.no_match = 0;
+  decode_stats.no_match_rules_tried = 0;
+  decode_compressed_stats.calls = decode_compressed_stats.no_match = 0;
+  decode_compressed_stats.no_match_rules_tried = 0;
+}
+
+#else
+
+#define DECODE_STATS_BEGIN(proc)
+#define DECODE_STATS_RULE()
+#define DECODE_STATS_GUARD(call) (call)
+#define DECODE_STATS_MATCH(case_id)
+#define DECODE_STATS_NO_MATCH()
+
+#endif
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef __RISCV_IMAGE_INPUT_H__
+#define __RISCV_IMAGE_INPUT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Memory-maps an ELF file or a raw image and finds the code in it, so that
+// decode_block(), scan_instruction_boundaries() or sweep_parallel() can read
+// the instructions straight from the mapped pages, without copying them into
+// a buffer first. The file is never read as a whole : pages are faulted in as
+// the decoders reach them, the kernel is told that they will be read in order,
+// and image_release() lets go of those already processed, so that images
+// larger than memory are disassembled in constant memory
+//
+// The code of an ELF file is in its executable sections (SHF_EXECINSTR), or in
+// its executable segments (PF_X) if it has no section headers. A file that
+// isn't an ELF file is a single region of code loaded at the address given to
+// image_open()
+
+#define RV_ELF_MACHINE_RISCV 243
+
+typedef struct RVImageRegion {
+  const uint8_t *data;
+  size_t len;
+  // where data is loaded
+  uint64_t address;
+} RVImageRegion;
+
+typedef struct RVImage {
+  const uint8_t *map;
+  size_t size;
+  RVImageRegion *regions;
+  size_t nregions;
+  // 32 or 64 for an ELF file, from its class, 0 for a raw image
+  uint16_t xlen;
+} RVImage;
+
+static inline uint64_t image_read_le(const uint8_t *p, int bytes) {
+  uint64_t v = 0;
+  for (int i = bytes - 1; i >= 0; i--) {
+    v = (v << 8) | p[i];
+  }
+  return v;
+}
+
+static inline int image_add_region(RVImage *image, uint64_t offset,
+                                   uint64_t len, uint64_t address) {
+  if (len == 0) {
+    return 1;
+  }
+  if (offset > image->size || len > image->size - offset) {
+    return 0;
+  }
+  RVImageRegion *regions =
+      realloc(image->regions, (image->nregions + 1) * sizeof(RVImageRegion));
+  if (!regions) {
+    return 0;
+  }
+  image->regions = regions;
+  image->regions[image->nregions++] =
+      (RVImageRegion){image->map + offset, (size_t)len, address};
+  return 1;
+}
+
+// Fills the regions of an ELF file, returns 0 if it is malformed or isn't a
+// little-endian RISC-V one
+static inline int image_find_elf_code(RVImage *image) {
+  const uint8_t *e = image->map;
+  if (image->size < 52 || (e[4] != 1 && e[4] != 2) || e[5] != 1 ||
+      image_read_le(e + 18, 2) != RV_ELF_MACHINE_RISCV) {
+    return 0;
+  }
+  int is64 = e[4] == 2;
+  int word = is64 ? 8 : 4;
+  if (is64 && image->size < 64) {
+    return 0;
+  }
+  image->xlen = is64 ? 64 : 32;
+  uint64_t shoff = image_read_le(e + (is64 ? 40 : 32), word);
+  uint64_t shentsize = image_read_le(e + (is64 ? 58 : 46), 2);
+  uint64_t shnum = image_read_le(e + (is64 ? 60 : 48), 2);
+  if (shoff != 0 && shnum != 0) {
+    if (shentsize < (is64 ? 64u : 40u) || shoff > image->size ||
+        shnum > (image->size - shoff) / shentsize) {
+      return 0;
+    }
+    for (uint64_t i = 0; i < shnum; i++) {
+      const uint8_t *sh = e + shoff + i * shentsize;
+      uint64_t type = image_read_le(sh + 4, 4);
+      uint64_t flags = image_read_le(sh + 8, word);
+      // SHT_PROGBITS and SHF_EXECINSTR
+      if (type == 1 && (flags & 0x4)) {
+        uint64_t address = image_read_le(sh + 8 + word, word);
+        uint64_t offset = image_read_le(sh + 8 + 2 * word, word);
+        uint64_t size = image_read_le(sh + 8 + 3 * word, word);
+        if (!image_add_region(image, offset, size, address)) {
+          return 0;
+        }
+      }
+    }
+    return 1;
+  }
+  uint64_t phoff = image_read_le(e + (is64 ? 32 : 28), word);
+  uint64_t phentsize = image_read_le(e + (is64 ? 54 : 42), 2);
+  uint64_t phnum = image_read_le(e + (is64 ? 56 : 44), 2);
+  if (phentsize < (is64 ? 56u : 32u) || phoff > image->size ||
+      phnum > (image->size - phoff) / phentsize) {
+    return 0;
+  }
+  for (uint64_t i = 0; i < phnum; i++) {
+    const uint8_t *ph = e + phoff + i * phentsize;
+    // PT_LOAD and PF_X, the flags come before the offset in 64-bit headers
+    uint64_t flags = image_read_le(ph + (is64 ? 4 : 24), 4);
+    if (image_read_le(ph, 4) == 1 && (flags & 0x1)) {
+      uint64_t offset = image_read_le(ph + (is64 ? 8 : 4), word);
+      uint64_t address = image_read_le(ph + (is64 ? 16 : 8), word);
+      uint64_t size = image_read_le(ph + (is64 ? 32 : 16), word);
+      if (!image_add_region(image, offset, size, address)) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+static inline void image_close(RVImage *image) {
+  if (image->map) {
+    munmap((void *)image->map, image->size);
+  }
+  free(image->regions);
+  image->map = NULL;
+  image->size = 0;
+  image->regions = NULL;
+  image->nregions = 0;
+}
+
+// Maps the file at path and finds the code in it, raw_address is where a file
+// that isn't an ELF file is loaded. Returns 0 if the file can't be mapped, or
+// is a malformed or non-RISC-V ELF file
+static inline int image_open(const char *path, uint64_t raw_address,
+                             RVImage *image) {
+  image->map = NULL;
+  image->size = 0;
+  image->regions = NULL;
+  image->nregions = 0;
+  image->xlen = 0;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    close(fd);
+    return 0;
+  }
+  void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping keeps the file open
+  close(fd);
+  if (map == MAP_FAILED) {
+    return 0;
+  }
+  image->map = map;
+  image->size = (size_t)st.st_size;
+  madvise(map, image->size, MADV_SEQUENTIAL);
+  int ok;
+  if (image->size >= 4 && image->map[0] == 0x7F && image->map[1] == 'E' &&
+      image->map[2] == 'L' && image->map[3] == 'F') {
+    ok = image_find_elf_code(image);
+  } else {
+    ok = image_add_region(image, 0, image->size, raw_address);
+  }
+  if (!ok) {
+    image_close(image);
+  }
+  return ok;
+}
+
+// Tells the kernel that the first len bytes of region won't be read again,
+// their pages are dropped from memory and faulted back in from the file if
+// they are. Only the pages entirely within region are released
+static inline void image_release(const RVImageRegion *region, size_t len) {
+  uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+  uintptr_t start = ((uintptr_t)region->data + page - 1) & ~(page - 1);
+  uintptr_t end = ((uintptr_t)region->data + len) & ~(page - 1);
+  if (end > start) {
+    madvise((void *)start, end - start, MADV_DONTNEED);
+  }
+}
+
+#endif
+
+#endif
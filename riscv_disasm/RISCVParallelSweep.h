@@ -0,0 +1,406 @@
+#ifndef __RISCV_PARALLEL_SWEEP_H__
+#define __RISCV_PARALLEL_SWEEP_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32) && !defined(RISCV_SWEEP_NO_THREADS)
+#include <pthread.h>
+#define RISCV_SWEEP_THREADS
+#endif
+
+#include "RISCVDecodeBlock.h"
+
+// Linear-sweep disassembly of a large buffer on several threads. The buffer is
+// split into one chunk per thread, and every thread sweeps its chunk from its
+// first parcel, speculating that an instruction starts there. That is wrong
+// when the last instruction of the previous chunk is a 32-bit one running over
+// the boundary, the merge step then re-decodes the start of the chunk from
+// where that instruction really ends, until it reaches an instruction the
+// thread also found. Both sweeps are the same from there on, mixed 16/32-bit
+// streams usually agree again within a few instructions
+//
+// Parcels starting a 48-bit or longer instruction, which no decoder handles,
+// are stepped over one at a time and reported as not decoded, so that the
+// sweep always covers the whole buffer like a serial one would
+//
+// Without pthreads (or with RISCV_SWEEP_NO_THREADS defined) the chunks are
+// swept one after the other, with the same results
+
+#ifndef RISCV_SWEEP_MIN_CHUNK
+// in bytes, smaller buffers are swept by fewer threads
+#define RISCV_SWEEP_MIN_CHUNK (64 * 1024)
+#endif
+
+typedef struct RVSweepInsn {
+  uint64_t address;
+  struct ast tree;
+  uint8_t length;
+  // 0 for a parcel starting an instruction too long to decode, tree is then
+  // zeroed out
+  uint8_t decoded;
+} RVSweepInsn;
+
+typedef struct RVSweepResult {
+  // in address order
+  RVSweepInsn *insns;
+  size_t count;
+} RVSweepResult;
+
+typedef struct RVSweepList {
+  RVSweepInsn *insns;
+  size_t count;
+  size_t capacity;
+} RVSweepList;
+
+typedef struct RVSweepChunk {
+  const uint8_t *buf;
+  size_t len;
+  uint64_t address;
+  size_t start;
+  size_t end;
+  RVContext ctx;
+  RVSweepList found;
+  // where the instruction after the last one found starts, end or a little
+  // past it
+  size_t resume;
+  // set if an allocation failed
+  int failed;
+} RVSweepChunk;
+
+static inline int sweep_list_reserve(RVSweepList *list, size_t count) {
+  if (count <= list->capacity) {
+    return 1;
+  }
+  size_t capacity = list->capacity ? list->capacity * 2 : 64;
+  while (capacity < count) {
+    capacity *= 2;
+  }
+  RVSweepInsn *insns = realloc(list->insns, capacity * sizeof(RVSweepInsn));
+  if (!insns) {
+    return 0;
+  }
+  list->insns = insns;
+  list->capacity = capacity;
+  return 1;
+}
+
+// Decodes the instruction at offset in buf into out, returns its length or 0
+// if it isn't entirely contained in buf
+static inline size_t sweep_step(const uint8_t *buf, size_t len, size_t offset,
+                                uint64_t address, RVSweepInsn *out,
+                                RVContext *ctx) {
+  if (offset + 2 > len) {
+    return 0;
+  }
+  uint16_t parcel = buf[offset] | (buf[offset + 1] << 8);
+  uint8_t insn_len = instruction_length(parcel);
+  out->address = address + offset;
+  out->decoded = 1;
+  if (insn_len == 2) {
+    decode_compressed(&out->tree, parcel, ctx);
+  } else if (insn_len == 4) {
+    if (offset + 4 > len) {
+      return 0;
+    }
+    uint64_t binary_stream = parcel | ((uint64_t)buf[offset + 2] << 16) |
+                             ((uint64_t)buf[offset + 3] << 24);
+    decode(&out->tree, binary_stream, ctx);
+  } else {
+    memset(&out->tree, 0, sizeof(out->tree));
+    out->decoded = 0;
+    insn_len = 2;
+  }
+  out->length = insn_len;
+  return insn_len;
+}
+
+// Sweeps from offset while it's before end, appending to list. Returns the
+// offset reached, or sets *failed
+static inline size_t sweep_range(const uint8_t *buf, size_t len,
+                                 uint64_t address, size_t offset, size_t end,
+                                 RVContext *ctx, RVSweepList *list,
+                                 int *failed) {
+  while (offset < end) {
+    if (!sweep_list_reserve(list, list->count + 1)) {
+      *failed = 1;
+      break;
+    }
+    size_t step = sweep_step(buf, len, offset, address,
+                             &list->insns[list->count], ctx);
+    if (step == 0) {
+      break;
+    }
+    list->count++;
+    offset += step;
+  }
+  return offset;
+}
+
+static inline void *sweep_chunk(void *arg) {
+  RVSweepChunk *chunk = arg;
+  // about 3 bytes per instruction in code mixing 16 and 32-bit instructions
+  if (sweep_list_reserve(&chunk->found, (chunk->end - chunk->start) / 3 + 1)) {
+    chunk->resume = sweep_range(chunk->buf, chunk->len, chunk->address,
+                                chunk->start, chunk->end, &chunk->ctx,
+                                &chunk->found, &chunk->failed);
+  } else {
+    chunk->failed = 1;
+  }
+  return NULL;
+}
+
+// Runs fn(args[i]) for i in [0, n), on up to n threads
+static inline void sweep_run(void *(*fn)(void *), void *args, size_t arg_size,
+                             unsigned n) {
+  unsigned first_serial = 0;
+#ifdef RISCV_SWEEP_THREADS
+  // the calling thread takes the first one, and those it couldn't start
+  // threads for
+  pthread_t *threads = malloc(n * sizeof(pthread_t));
+  uint8_t *started = calloc(n, 1);
+  if (threads && started) {
+    for (unsigned i = 1; i < n; i++) {
+      started[i] = pthread_create(&threads[i], NULL, fn,
+                                  (uint8_t *)args + i * arg_size) == 0;
+    }
+    fn(args);
+    for (unsigned i = 1; i < n; i++) {
+      if (started[i]) {
+        pthread_join(threads[i], NULL);
+      } else {
+        fn((uint8_t *)args + i * arg_size);
+      }
+    }
+    first_serial = n;
+  }
+  free(threads);
+  free(started);
+#endif
+  for (unsigned i = first_serial; i < n; i++) {
+    fn((uint8_t *)args + i * arg_size);
+  }
+}
+
+// Re-decodes into repairs from offset, the start of an instruction, until
+// reaching resume or the first instruction that found also holds, whose index
+// is stored in *k. Returns the offset reached
+//
+// Where the instructions start is scanned a block of parcels at a time and
+// matched against the starts the chunk found in that block, so that the
+// meeting point is known before decoding the instructions leading to it
+static inline size_t sweep_resync(const uint8_t *buf, size_t len,
+                                  uint64_t address, size_t offset,
+                                  size_t resume, RVContext *ctx,
+                                  const RVSweepList *found, size_t *k,
+                                  RVSweepList *repairs, int *failed) {
+  size_t f = 0;
+  while (offset < resume) {
+    while (f < found->count && found->insns[f].address - address < offset) {
+      f++;
+    }
+    if (f < found->count && found->insns[f].address - address == offset) {
+      break;
+    }
+    size_t nparcels = (len - offset) / 2;
+    if (nparcels > PARCELS_PER_SCAN_BLOCK) {
+      nparcels = PARCELS_PER_SCAN_BLOCK;
+    }
+    uint64_t starts = 0;
+    uint8_t lengths[PARCELS_PER_SCAN_BLOCK];
+    size_t count =
+        scan_instruction_boundaries(buf + offset, nparcels, &starts, lengths);
+    // the chunks start on parcels, so every instruction they found does too
+    uint64_t found_starts = 0;
+    for (size_t g = f; g < found->count; g++) {
+      size_t parcel = (found->insns[g].address - address - offset) / 2;
+      if (parcel >= nparcels) {
+        break;
+      }
+      found_starts |= 1ULL << parcel;
+    }
+    uint64_t meeting = starts & found_starts;
+    uint64_t to_decode = meeting ? starts & ((meeting & -meeting) - 1) : starts;
+    for (; to_decode && offset < resume; to_decode &= to_decode - 1) {
+      if (!sweep_list_reserve(repairs, repairs->count + 1)) {
+        *failed = 1;
+        return offset;
+      }
+      offset += sweep_step(buf, len, offset, address,
+                           &repairs->insns[repairs->count], ctx);
+      repairs->count++;
+    }
+    if (count > 0) {
+      continue;
+    }
+    // No instruction the decoders handle starts at offset : one too long to
+    // decode, stepped over alone, or one cut off by the end of buf
+    size_t reached = sweep_range(buf, len, address, offset, offset + 1, ctx,
+                                 repairs, failed);
+    if (reached == offset) {
+      break;
+    }
+    offset = reached;
+  }
+  while (f < found->count && found->insns[f].address - address < offset) {
+    f++;
+  }
+  *k = f;
+  return offset;
+}
+
+// Disassembles the len bytes of buf, loaded at address, on up to nthreads
+// threads. The instructions are returned in result, in address order, exactly
+// as a single sweep from the first byte would find them, and must be released
+// with sweep_result_free()
+//
+// Returns 0 if an allocation failed, result is then left empty
+static inline int sweep_parallel(const uint8_t *buf, size_t len,
+                                 uint64_t address, RVContext *ctx,
+                                 unsigned nthreads, RVSweepResult *result) {
+  result->insns = NULL;
+  result->count = 0;
+  size_t nchunks = len / RISCV_SWEEP_MIN_CHUNK;
+  if (nchunks > nthreads) {
+    nchunks = nthreads;
+  }
+  if (nchunks == 0) {
+    nchunks = 1;
+  }
+  // chunks start on parcels
+  size_t chunk_len = (len / nchunks + 1) & ~(size_t)1;
+  RVSweepChunk *chunks = calloc(nchunks, sizeof(RVSweepChunk));
+  if (!chunks) {
+    return 0;
+  }
+  for (size_t i = 0; i < nchunks; i++) {
+    chunks[i].buf = buf;
+    chunks[i].len = len;
+    chunks[i].address = address;
+    chunks[i].start = i * chunk_len < len ? i * chunk_len : len;
+    chunks[i].end = i == nchunks - 1 || (i + 1) * chunk_len > len
+                        ? len
+                        : (i + 1) * chunk_len;
+    chunks[i].ctx = *ctx;
+  }
+  sweep_run(sweep_chunk, chunks, sizeof(RVSweepChunk), nchunks);
+
+  // Merging : next is where the instruction after those already merged
+  // starts. A chunk whose first instructions aren't on that path has them
+  // dropped, and replaced by those re-decoded from next until the two sweeps
+  // meet at the same instruction
+  int failed = 0;
+  size_t total = 0;
+  size_t next = 0;
+  RVSweepList *repairs = calloc(nchunks, sizeof(RVSweepList));
+  size_t *first_kept = calloc(nchunks, sizeof(size_t));
+  if (!repairs || !first_kept) {
+    failed = 1;
+  }
+  for (size_t i = 0; i < nchunks && !failed; i++) {
+    RVSweepChunk *chunk = &chunks[i];
+    if (chunk->failed) {
+      failed = 1;
+      break;
+    }
+    RVSweepList *found = &chunk->found;
+    size_t k = 0;
+    size_t offset = sweep_resync(buf, len, address, next, chunk->resume, ctx,
+                                 found, &k, &repairs[i], &failed);
+    if (k < found->count && found->insns[k].address - address == offset) {
+      first_kept[i] = k;
+      next = chunk->resume;
+    } else {
+      first_kept[i] = found->count;
+      next = offset;
+    }
+    total += repairs[i].count + found->count - first_kept[i];
+  }
+
+  if (!failed && total > 0) {
+    result->insns = malloc(total * sizeof(RVSweepInsn));
+    failed = !result->insns;
+  }
+  for (size_t i = 0; i < nchunks && !failed; i++) {
+    RVSweepList *found = &chunks[i].found;
+    memcpy(result->insns + result->count, repairs[i].insns,
+           repairs[i].count * sizeof(RVSweepInsn));
+    result->count += repairs[i].count;
+    memcpy(result->insns + result->count, found->insns + first_kept[i],
+           (found->count - first_kept[i]) * sizeof(RVSweepInsn));
+    result->count += found->count - first_kept[i];
+  }
+  for (size_t i = 0; i < nchunks; i++) {
+    free(chunks[i].found.insns);
+    if (repairs) {
+      free(repairs[i].insns);
+    }
+  }
+  free(chunks);
+  free(repairs);
+  free(first_kept);
+  if (failed) {
+    free(result->insns);
+    result->insns = NULL;
+    result->count = 0;
+    return 0;
+  }
+  return 1;
+}
+
+static inline void sweep_result_free(RVSweepResult *result) {
+  free(result->insns);
+  result->insns = NULL;
+  result->count = 0;
+}
+
+// Calls visit() on consecutive slices of the instructions of result, on up to
+// nthreads threads at once, e.g. to run ast2str() on all of them in parallel.
+// Slice i holds the instructions preceding those of slice i + 1, so that the
+// caller can put what it produces for each slice back in address order
+typedef void (*RVSweepVisitor)(const RVSweepInsn *insns, size_t count,
+                               unsigned slice, void *arg);
+
+typedef struct RVSweepSlice {
+  const RVSweepInsn *insns;
+  size_t count;
+  unsigned index;
+  RVSweepVisitor visit;
+  void *arg;
+} RVSweepSlice;
+
+static inline void *sweep_visit_slice(void *arg) {
+  RVSweepSlice *slice = arg;
+  slice->visit(slice->insns, slice->count, slice->index, slice->arg);
+  return NULL;
+}
+
+// Returns the number of slices visited, 0 if an allocation failed
+static inline unsigned sweep_visit_parallel(const RVSweepResult *result,
+                                            unsigned nthreads,
+                                            RVSweepVisitor visit, void *arg) {
+  unsigned nslices = nthreads ? nthreads : 1;
+  if (result->count < nslices) {
+    nslices = result->count ? result->count : 1;
+  }
+  RVSweepSlice *slices = malloc(nslices * sizeof(RVSweepSlice));
+  if (!slices) {
+    return 0;
+  }
+  size_t per_slice = (result->count + nslices - 1) / nslices;
+  for (unsigned i = 0; i < nslices; i++) {
+    size_t first = i * per_slice < result->count ? i * per_slice
+                                                 : result->count;
+    size_t last = first + per_slice < result->count ? first + per_slice
+                                                    : result->count;
+    slices[i] = (RVSweepSlice){result->insns + first, last - first, i, visit,
+                               arg};
+  }
+  sweep_run(sweep_visit_slice, slices, sizeof(RVSweepSlice), nslices);
+  free(slices);
+  return nslices;
+}
+
+#endif
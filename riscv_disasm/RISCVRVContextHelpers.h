@@ -72,6 +72,9 @@ typedef struct RVContext {
   uint32_t misa;
   uint64_t mstatus;
   uint64_t extensionsSupported;
+  // cached currentlyEnabled() for every extension, derived from the fields
+  // above by updateEnabledExtensions(), only read once generation isn't 0
+  uint64_t enabledExtensions;
 
   uint64_t vtype;
   uint64_t vl;
@@ -81,6 +84,12 @@ typedef struct RVContext {
   // constants
   uint8_t zreg;
   uint8_t sp;
+
+  // bumped by every call to updateEnabledExtensions(), lets caches of
+  // decoding results tell the states of a context apart. 0 until then, which
+  // makes the decoders resolve the extensions from the fields above on every
+  // check
+  uint64_t generation;
 } RVContext;
 
 #endif
\ No newline at end of file
@@ -0,0 +1,339 @@
+// Times every stage of disassembling an instruction separately : decode (or
+// decode_compressed), ast2str, fill_operands + patch_operands and
+// get_insn_type, over valid instructions of each extension group, then decode
+// alone for each ast case, to find the cases whose rules are tried last
+//
+// Instructions are sampled at random from the whole encoding space, and put in
+// the first group whose extensions they need : an instruction needs a group if
+// it no longer decodes once the extensions of that group are disabled. The
+// compressed group holds every valid 16-bit encoding. Cycles are read from the
+// time-stamp counter where there is one, they are reference cycles rather than
+// core cycles on CPUs that scale their frequency
+//
+// Build and run with `make run` from this directory, see the Makefile
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC
+#endif
+
+// The vector helpers print an error for some vtype values while decoding, the
+// messages are counted instead of flooding the report
+static unsigned long helper_messages;
+#define RISCV_HELPER_ERROR(...) (helper_messages++)
+
+#include "RISCVAst2Str.gen.inc"
+#include "RISCVDecode.gen.inc"
+#include "RISCVDecodeCompressed.gen.inc"
+#include "RISCVInsnMappings.gen.inc"
+#include "RISCVOperands.gen.inc"
+
+// valid instructions sampled per group, and at most this many random words
+// are drawn to find them
+#define WORDS_PER_GROUP 4096
+#define MAX_DRAWS (64ULL << 20)
+// every measurement runs over at least this many instructions
+#define MIN_TIMED_INSNS (2u << 20)
+#define MAX_OPS 16
+#define WORST_CASES_SHOWN 15
+
+typedef struct BenchGroup {
+  const char *name;
+  // the extensions the hart stops supporting to tell whether an instruction
+  // needs this group
+  uint64_t extensions;
+  uint32_t words[WORDS_PER_GROUP];
+  size_t count;
+} BenchGroup;
+
+// In classification order, an instruction needing both F and V extensions
+// is a vector one. The base group takes the rest
+static BenchGroup groups[] = {
+    {"C", 0},
+    {"V",
+     RISCV_Ext_V | RISCV_Ext_Zvbb | RISCV_Ext_Zvkb | RISCV_Ext_Zvbc |
+         RISCV_Ext_Zvknha | RISCV_Ext_Zvknhb},
+    {"F/D",
+     RISCV_Ext_F | RISCV_Ext_D | RISCV_Ext_Zfa | RISCV_Ext_Zfh |
+         RISCV_Ext_Zfhmin | RISCV_Ext_Zfinx | RISCV_Ext_Zdinx |
+         RISCV_Ext_Zhinx},
+    {"A",
+     RISCV_Ext_A | RISCV_Ext_Zaamo | RISCV_Ext_Zabha | RISCV_Ext_Zalrsc},
+    {"M", RISCV_Ext_M | RISCV_Ext_Zmmul},
+    {"K",
+     RISCV_Ext_Zknd | RISCV_Ext_Zkne | RISCV_Ext_Zknh | RISCV_Ext_Zkr |
+         RISCV_Ext_Zksed | RISCV_Ext_Zksh | RISCV_Ext_Zbkb | RISCV_Ext_Zbkc |
+         RISCV_Ext_Zbkx},
+    {"B",
+     RISCV_Ext_B | RISCV_Ext_Zba | RISCV_Ext_Zbb | RISCV_Ext_Zbc |
+         RISCV_Ext_Zbs},
+    {"base", 0},
+};
+
+#define NUM_GROUPS (sizeof(groups) / sizeof(groups[0]))
+#define COMPRESSED_GROUP 0
+#define BASE_GROUP (NUM_GROUPS - 1)
+
+typedef struct BenchCost {
+  double ns;
+  double cycles;
+} BenchCost;
+
+static volatile uint64_t sink;
+
+static double now_ns(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static uint64_t ticks(void) {
+#ifdef BENCH_HAVE_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+// Runs body for i in [0, count) as many times as needed to time at least
+// MIN_TIMED_INSNS instructions
+#define MEASURE(cost, count, body)                                            \
+  do {                                                                        \
+    size_t timed_ = 0;                                                        \
+    double start_ns_ = now_ns();                                              \
+    uint64_t start_ticks_ = ticks();                                          \
+    while ((count) > 0 && timed_ < MIN_TIMED_INSNS) {                         \
+      for (size_t i = 0; i < (count); i++) {                                  \
+        body;                                                                 \
+      }                                                                       \
+      timed_ += (count);                                                      \
+    }                                                                         \
+    (cost).ns = timed_ ? (now_ns() - start_ns_) / timed_ : 0;                 \
+    (cost).cycles = timed_ ? (double)(ticks() - start_ticks_) / timed_ : 0;   \
+  } while (0)
+
+static uint64_t rng_state = 88172645463325252ULL;
+
+static uint32_t next_random(void) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return (uint32_t)rng_state;
+}
+
+static int is_illegal(const struct ast *tree) {
+  return tree->ast_node_type == RISCV_ILLEGAL ||
+         tree->ast_node_type == RISCV_C_ILLEGAL;
+}
+
+static void decode_any(struct ast *tree, uint32_t word, RVContext *ctx) {
+  if ((word & 0x3) != 0x3) {
+    decode_compressed(tree, word, ctx);
+  } else {
+    decode(tree, word, ctx);
+  }
+}
+
+static void init_context(RVContext *ctx) {
+  memset(ctx, 0, sizeof(*ctx));
+  ctx->xlen = 64;
+  ctx->xlen_bytes = 8;
+  ctx->flen = 64;
+  ctx->misa = ~0u;
+  ctx->mstatus = ~0ULL;
+  ctx->extensionsSupported = ~0ULL;
+  ctx->vtype = 3 << 3;
+  ctx->vl = 4;
+  ctx->vlen = 128;
+  ctx->sp = 2;
+  // every extension the hart supports is enabled by misa and mstatus
+  updateEnabledExtensions(ctx);
+}
+
+static void sample_groups(RVContext *ctx) {
+  struct ast tree;
+  for (uint32_t p = 0; p <= 0xFFFF; p++) {
+    BenchGroup *c = &groups[COMPRESSED_GROUP];
+    if ((p & 0x3) != 0x3 && c->count < WORDS_PER_GROUP) {
+      decode_compressed(&tree, p, ctx);
+      if (!is_illegal(&tree)) {
+        c->words[c->count++] = p;
+      }
+    }
+  }
+  uint64_t all_extensions = ctx->extensionsSupported;
+  for (uint64_t draw = 0; draw < MAX_DRAWS; draw++) {
+    uint32_t word = next_random() | 0x3;
+    if ((word & 0x1C) == 0x1C) {
+      continue;
+    }
+    decode(&tree, word, ctx);
+    if (is_illegal(&tree)) {
+      continue;
+    }
+    size_t g = COMPRESSED_GROUP + 1;
+    for (; g < BASE_GROUP; g++) {
+      ctx->extensionsSupported = all_extensions & ~groups[g].extensions;
+      updateEnabledExtensions(ctx);
+      decode(&tree, word, ctx);
+      ctx->extensionsSupported = all_extensions;
+      updateEnabledExtensions(ctx);
+      if (is_illegal(&tree)) {
+        break;
+      }
+    }
+    if (groups[g].count < WORDS_PER_GROUP) {
+      groups[g].words[groups[g].count++] = word;
+    }
+    int full = 1;
+    for (g = COMPRESSED_GROUP + 1; g < NUM_GROUPS; g++) {
+      full &= groups[g].count == WORDS_PER_GROUP;
+    }
+    if (full) {
+      break;
+    }
+  }
+}
+
+static void bench_group(BenchGroup *g, RVContext *ctx) {
+  static struct ast trees[WORDS_PER_GROUP];
+  BenchCost decoding, stringifying, operands, insn_type;
+  SStream ss;
+  cs_riscv_op ops[MAX_OPS];
+  uint8_t op_count;
+  if (g - groups == COMPRESSED_GROUP) {
+    MEASURE(decoding, g->count, {
+      decode_compressed(&trees[i], g->words[i], ctx);
+      sink += trees[i].ast_node_type;
+    });
+  } else {
+    MEASURE(decoding, g->count, {
+      decode(&trees[i], g->words[i], ctx);
+      sink += trees[i].ast_node_type;
+    });
+  }
+  MEASURE(stringifying, g->count, {
+    SStream_Init(&ss);
+    ast2str(&trees[i], &ss, ctx);
+    sink += ss.index;
+  });
+  MEASURE(operands, g->count, {
+    op_count = 0;
+    fill_operands(&trees[i], ops, &op_count);
+    patch_operands(&trees[i], ops, &op_count, ctx);
+    sink += op_count;
+  });
+  MEASURE(insn_type, g->count, { sink += get_insn_type(&trees[i]); });
+  printf("%-5s %6zu %8.1f %7.1f %8.1f %7.1f %8.1f %7.1f %8.1f %7.1f\n",
+         g->name, g->count, decoding.ns, decoding.cycles, stringifying.ns,
+         stringifying.cycles, operands.ns, operands.cycles, insn_type.ns,
+         insn_type.cycles);
+}
+
+typedef struct BenchCase {
+  uint16_t case_id;
+  uint32_t *words;
+  size_t count;
+  BenchCost decoding;
+} BenchCase;
+
+static int by_decode_cost(const void *a, const void *b) {
+  double ca = ((const BenchCase *)a)->decoding.ns;
+  double cb = ((const BenchCase *)b)->decoding.ns;
+  return (ca < cb) - (ca > cb);
+}
+
+// Decode alone, for the words of each ast case
+static void bench_cases(RVContext *ctx) {
+  size_t total = 0;
+  for (size_t g = 0; g < NUM_GROUPS; g++) {
+    total += groups[g].count;
+  }
+  uint16_t *case_ids = malloc(total * sizeof(uint16_t));
+  uint32_t *words = malloc(total * sizeof(uint32_t));
+  BenchCase *cases = calloc(1 << 16, sizeof(BenchCase));
+  if (!case_ids || !words || !cases) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  struct ast tree;
+  size_t n = 0;
+  for (size_t g = 0; g < NUM_GROUPS; g++) {
+    for (size_t i = 0; i < groups[g].count; i++) {
+      decode_any(&tree, groups[g].words[i], ctx);
+      case_ids[n] = tree.ast_node_type;
+      cases[tree.ast_node_type].count++;
+      n++;
+    }
+  }
+  // words grouped by case, in case order
+  size_t offset = 0;
+  for (size_t c = 0; c < (1 << 16); c++) {
+    cases[c].case_id = c;
+    cases[c].words = words + offset;
+    offset += cases[c].count;
+    cases[c].count = 0;
+  }
+  n = 0;
+  for (size_t g = 0; g < NUM_GROUPS; g++) {
+    for (size_t i = 0; i < groups[g].count; i++) {
+      BenchCase *c = &cases[case_ids[n++]];
+      c->words[c->count++] = groups[g].words[i];
+    }
+  }
+  size_t ncases = 0;
+  for (size_t c = 0; c < (1 << 16); c++) {
+    if (cases[c].count == 0) {
+      continue;
+    }
+    BenchCase *bc = &cases[c];
+    MEASURE(bc->decoding, bc->count, {
+      decode_any(&tree, bc->words[i], ctx);
+      sink += tree.ast_node_type;
+    });
+    cases[ncases++] = *bc;
+  }
+  qsort(cases, ncases, sizeof(BenchCase), by_decode_cost);
+  printf("\nSlowest ast cases to decode (%zu cases sampled)\n", ncases);
+  printf("%5s %6s %8s %7s  %s\n", "case", "insns", "ns", "cycles", "example");
+  for (size_t c = 0; c < ncases && c < WORST_CASES_SHOWN; c++) {
+    SStream ss;
+    SStream_Init(&ss);
+    decode_any(&tree, cases[c].words[0], ctx);
+    ast2str(&tree, &ss, ctx);
+    printf("%5u %6zu %8.1f %7.1f  %s\n", cases[c].case_id, cases[c].count,
+           cases[c].decoding.ns, cases[c].decoding.cycles, ss.buffer);
+  }
+  free(case_ids);
+  free(words);
+  free(cases);
+}
+
+int main(void) {
+  RVContext ctx;
+  init_context(&ctx);
+  sample_groups(&ctx);
+  printf("Per instruction, ns and %s\n\n",
+#ifdef BENCH_HAVE_TSC
+         "time-stamp counter cycles"
+#else
+         "cycles (no cycle counter on this target, 0)"
+#endif
+  );
+  printf("%-5s %6s %16s %16s %16s %16s\n", "group", "insns", "decode",
+         "ast2str", "operands", "insn_type");
+  for (size_t g = 0; g < NUM_GROUPS; g++) {
+    bench_group(&groups[g], &ctx);
+  }
+  bench_cases(&ctx);
+  if (helper_messages) {
+    printf("\n%lu error messages of the decode helpers were silenced\n",
+           helper_messages);
+  }
+  return 0;
+}
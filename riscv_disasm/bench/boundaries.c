@@ -0,0 +1,227 @@
+// Checks scan_instruction_boundaries() of RISCVBoundaryScan.h against the
+// scalar walk it replaces, following instruction_length() from one
+// instruction to the next, then the callers built on it : decode_block()
+// against decoding each instruction of that walk, and sweep_parallel() against
+// a single sweep of the whole buffer, with chunks small enough that most of
+// them need resynchronizing. Buffers are random parcels, mostly 16-bit and
+// 32-bit instruction starts with a few 48-bit or longer ones. Then times the
+// scan and the walk
+//
+// Build and run with `make run-boundaries` from this directory, see the
+// Makefile
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define RISCV_HELPER_ERROR(...) ((void)0)
+// many chunks even for the small buffers checked
+#define RISCV_SWEEP_MIN_CHUNK 64
+
+#include "RISCVParallelSweep.h"
+
+#define BUFFERS 2000
+#define MAX_PARCELS 1500
+#define MAX_BLOCK_INSNS 64
+#define TIMED_PARCELS (1u << 20)
+// every measurement walks at least this many parcels
+#define MIN_TIMED_PARCELS (256u << 20)
+
+static uint64_t state = 88172645463325252ULL;
+
+static uint64_t next_random(void) {
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+// 1 in 64 parcels has its 5 low bits set
+static void fill_parcels(uint8_t *buf, size_t nparcels) {
+  for (size_t i = 0; i < nparcels; i++) {
+    uint16_t p = next_random();
+    if ((p & 0x1F) == 0x1F && next_random() % 2) {
+      p &= ~0x4;
+    }
+    buf[2 * i] = p;
+    buf[2 * i + 1] = p >> 8;
+  }
+}
+
+// The serial walk : the same contract as scan_instruction_boundaries()
+static size_t walk_boundaries(const uint8_t *buf, size_t nparcels,
+                              uint64_t *starts, uint8_t *lengths) {
+  memset(starts, 0, (nparcels + 63) / 64 * sizeof(uint64_t));
+  size_t n = 0;
+  size_t i = 0;
+  while (i < nparcels) {
+    uint8_t insn_len = instruction_length(load_parcel(buf, i));
+    if (insn_len == 0 || i + insn_len / 2 > nparcels) {
+      break;
+    }
+    starts[i / 64] |= 1ULL << (i % 64);
+    lengths[n++] = insn_len;
+    i += insn_len / 2;
+  }
+  return n;
+}
+
+static int check_boundaries(const uint8_t *buf, size_t nparcels) {
+  uint64_t scan_starts[(MAX_PARCELS + 63) / 64];
+  uint64_t walk_starts[(MAX_PARCELS + 63) / 64];
+  uint8_t scan_lengths[MAX_PARCELS];
+  uint8_t walk_lengths[MAX_PARCELS];
+  size_t scanned =
+      scan_instruction_boundaries(buf, nparcels, scan_starts, scan_lengths);
+  size_t walked =
+      walk_boundaries(buf, nparcels, walk_starts, walk_lengths);
+  return scanned != walked ||
+         memcmp(scan_starts, walk_starts,
+                (nparcels + 63) / 64 * sizeof(uint64_t)) != 0 ||
+         memcmp(scan_lengths, walk_lengths, scanned) != 0;
+}
+
+static int check_decode_block(const uint8_t *buf, size_t len, RVContext *ctx) {
+  struct ast block[MAX_BLOCK_INSNS];
+  struct ast walked[MAX_BLOCK_INSNS];
+  uint8_t block_lengths[MAX_BLOCK_INSNS];
+  memset(block, 0, sizeof(block));
+  memset(walked, 0, sizeof(walked));
+  size_t max = next_random() % MAX_BLOCK_INSNS + 1;
+  size_t decoded;
+  size_t spanned =
+      decode_block(buf, len, block, block_lengths, max, &decoded, ctx);
+  size_t offset = 0;
+  size_t n = 0;
+  while (n < max && offset + 2 <= len) {
+    uint16_t parcel = load_parcel(buf + offset, 0);
+    uint8_t insn_len = instruction_length(parcel);
+    if (insn_len == 2) {
+      decode_compressed(&walked[n], parcel, ctx);
+    } else if (insn_len == 4 && offset + 4 <= len) {
+      decode(&walked[n], parcel | (uint64_t)load_parcel(buf + offset, 1) << 16,
+             ctx);
+    } else {
+      break;
+    }
+    if (block_lengths[n] != insn_len) {
+      return 1;
+    }
+    offset += insn_len;
+    n++;
+  }
+  return decoded != n || spanned != offset ||
+         memcmp(block, walked, n * sizeof(struct ast)) != 0;
+}
+
+// The sweeps don't zero out the trees they decode into, so the bytes of the
+// members that an ast case doesn't use differ between them
+static int same_insns(const RVSweepInsn *a, const RVSweepInsn *b) {
+  return a->address == b->address && a->length == b->length &&
+         a->decoded == b->decoded &&
+         a->tree.ast_node_type == b->tree.ast_node_type;
+}
+
+static int check_sweep(const uint8_t *buf, size_t len, RVContext *ctx) {
+  RVSweepList serial = {0};
+  int failed = 0;
+  sweep_range(buf, len, 0x1000, 0, len, ctx, &serial, &failed);
+  int differs = failed;
+  for (unsigned nthreads = 2; nthreads <= 16 && !differs; nthreads *= 2) {
+    RVSweepResult result;
+    if (!sweep_parallel(buf, len, 0x1000, ctx, nthreads, &result)) {
+      differs = 1;
+      break;
+    }
+    differs = result.count != serial.count;
+    for (size_t i = 0; i < result.count && !differs; i++) {
+      differs = !same_insns(&result.insns[i], &serial.insns[i]);
+    }
+    sweep_result_free(&result);
+  }
+  free(serial.insns);
+  return differs;
+}
+
+static double now_ns(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+typedef size_t (*BoundaryFinder)(const uint8_t *buf, size_t nparcels,
+                                 uint64_t *starts, uint8_t *lengths);
+
+// Returns the ns per parcel
+static double time_finder(BoundaryFinder find, const uint8_t *buf,
+                          uint64_t *starts, uint8_t *lengths) {
+  size_t parcels = 0;
+  size_t checksum = 0;
+  double start = now_ns();
+  while (parcels < MIN_TIMED_PARCELS) {
+    checksum += find(buf, TIMED_PARCELS, starts, lengths);
+    parcels += TIMED_PARCELS;
+  }
+  double ns = (now_ns() - start) / parcels;
+  // keeps the calls from being optimized out
+  if (checksum == 0) {
+    printf("no instructions found\n");
+  }
+  return ns;
+}
+
+int main(void) {
+  RVContext ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.xlen = 64;
+  ctx.xlen_bytes = 8;
+  ctx.flen = 64;
+  ctx.misa = ~0u;
+  ctx.mstatus = ~0ULL;
+  ctx.extensionsSupported = ~0ULL;
+  ctx.vtype = 3 << 3;
+  ctx.vl = 4;
+  ctx.vlen = 128;
+  updateEnabledExtensions(&ctx);
+
+  static uint8_t buf[2 * MAX_PARCELS];
+  unsigned boundaries = 0;
+  unsigned blocks = 0;
+  unsigned sweeps = 0;
+  for (unsigned b = 0; b < BUFFERS; b++) {
+    // odd lengths too, whose last byte is never part of an instruction
+    size_t len = next_random() % (2 * MAX_PARCELS) + 1;
+    fill_parcels(buf, MAX_PARCELS);
+    boundaries += check_boundaries(buf, len / 2);
+    blocks += check_decode_block(buf, len, &ctx);
+    sweeps += check_sweep(buf, len, &ctx);
+  }
+  printf("%u buffers : %u boundary scans, %u decode_block() calls and %u "
+         "parallel sweeps differ from the serial walk\n",
+         BUFFERS, boundaries, blocks, sweeps);
+
+  uint8_t *timed = malloc(2 * TIMED_PARCELS);
+  uint64_t *starts = malloc((TIMED_PARCELS + 63) / 64 * sizeof(uint64_t));
+  uint8_t *lengths = malloc(TIMED_PARCELS);
+  if (!timed || !starts || !lengths) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  // no 48-bit or longer instruction, for both to go through the whole buffer
+  fill_parcels(timed, TIMED_PARCELS);
+  for (size_t i = 0; i < TIMED_PARCELS; i++) {
+    if ((timed[2 * i] & 0x1F) == 0x1F) {
+      timed[2 * i] &= ~0x4;
+    }
+  }
+  double walk_ns = time_finder(walk_boundaries, timed, starts, lengths);
+  double scan_ns =
+      time_finder(scan_instruction_boundaries, timed, starts, lengths);
+  printf("ns per parcel : walk %.3f, scan %.3f (%.2fx)\n", walk_ns, scan_ns,
+         scan_ns > 0 ? walk_ns / scan_ns : 0.0);
+  free(timed);
+  free(starts);
+  free(lengths);
+  return boundaries + blocks + sweeps != 0;
+}
@@ -0,0 +1,215 @@
+// Compares the generated code of two versions of the generator over the whole
+// encoding space : every 16-bit parcel, and every 32-bit word (or every
+// stride-th one), are decoded, stringified and turned into operands by both a
+// reference build and a candidate build, under several context profiles, and
+// any difference is reported. The reference is a copy of riscv_disasm saved
+// with `make save-ref` before changing the generator or its options, the
+// candidate is riscv_disasm as regenerated afterwards
+//
+//   difftest [stride [threads]]
+//
+// Only the profile named by the environment variable DIFFTEST_PROFILE is
+// compared when it is set, for code generated with -profile
+//
+// The stride should be odd, for the sampled words to have every value of their
+// low bits
+//
+// The 32-bit words are those whose low bits make them 32-bit instructions, the
+// others are either compressed or longer than any decoder handles. They are
+// split between threads in blocks, so a full sweep takes 2^30 * 7/8 words per
+// profile
+//
+// Build and run with `make difftest` from this directory, see the Makefile
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "difftest.h"
+
+#define MAX_REPORTED 20
+// words handed out to a thread at once
+#define BLOCK_WORDS (1u << 16)
+
+typedef struct DiffSweep {
+  unsigned profile;
+  int compressed;
+  uint64_t stride;
+  // words are i * stride for i in [0, count)
+  uint64_t count;
+  uint64_t next;
+  uint64_t mismatches;
+  uint64_t compared;
+  pthread_mutex_t lock;
+} DiffSweep;
+
+static size_t ast_size;
+
+// Returns what differs between the two results, or the optional output of
+// either build that disagrees with its own decoder, NULL if nothing does
+static const char *difference(const DiffResult *ref, const DiffResult *cand) {
+  if (ref->case_id != cand->case_id) {
+    return "ast case";
+  }
+  if (memcmp(ref->ast, cand->ast, ast_size) != 0) {
+    return "ast members";
+  }
+  if (ref->insn_type != cand->insn_type) {
+    return "instruction type";
+  }
+  if (strcmp(ref->text, cand->text) != 0) {
+    return "ast2str";
+  }
+  if (ref->op_count != cand->op_count) {
+    return "operand count";
+  }
+  for (uint8_t i = 0; i < ref->op_count && i < DIFF_MAX_OPS; i++) {
+    const cs_riscv_op *a = &ref->ops[i];
+    const cs_riscv_op *b = &cand->ops[i];
+    int same = a->type == b->type && a->access == b->access;
+    switch (a->type) {
+    case RISCV_OP_REG:
+      same &= a->reg == b->reg;
+      break;
+    case RISCV_OP_IMM:
+      same &= a->imm == b->imm;
+      break;
+    case RISCV_OP_MEM:
+      same &= a->mem.base == b->mem.base && a->mem.disp == b->mem.disp &&
+              a->mem.type == b->mem.type;
+      break;
+    default:
+      break;
+    }
+    if (!same) {
+      return "operands";
+    }
+  }
+  return cand->inconsistent ? cand->inconsistent : ref->inconsistent;
+}
+
+static void *sweep_thread(void *arg) {
+  DiffSweep *sweep = arg;
+  DiffResult ref, cand;
+  for (;;) {
+    uint64_t first = __atomic_fetch_add(&sweep->next, BLOCK_WORDS,
+                                        __ATOMIC_RELAXED);
+    if (first >= sweep->count) {
+      break;
+    }
+    uint64_t last = first + BLOCK_WORDS < sweep->count ? first + BLOCK_WORDS
+                                                       : sweep->count;
+    uint64_t compared = 0;
+    for (uint64_t i = first; i < last; i++) {
+      uint32_t word = (uint32_t)(i * sweep->stride);
+      if (sweep->compressed ? (word & 0x3) == 0x3
+                            : (word & 0x3) != 0x3 || (word & 0x1C) == 0x1C) {
+        continue;
+      }
+      compared++;
+      ref_disasm(word, sweep->compressed, sweep->profile, &ref);
+      cand_disasm(word, sweep->compressed, sweep->profile, &cand);
+      const char *what = difference(&ref, &cand);
+      if (!what) {
+        continue;
+      }
+      pthread_mutex_lock(&sweep->lock);
+      if (sweep->mismatches++ < MAX_REPORTED) {
+        printf("  %s 0x%0*X: %s differs\n    reference: case %u, %s\n"
+               "    candidate: case %u, %s\n",
+               ref_profile_name(sweep->profile), sweep->compressed ? 4 : 8,
+               word, what, ref.case_id, ref.text, cand.case_id, cand.text);
+      }
+      pthread_mutex_unlock(&sweep->lock);
+    }
+    __atomic_fetch_add(&sweep->compared, compared, __ATOMIC_RELAXED);
+  }
+  return NULL;
+}
+
+static double now_seconds(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// Returns the number of mismatches
+static uint64_t run_sweep(unsigned profile, int compressed, uint64_t stride,
+                          unsigned nthreads) {
+  DiffSweep sweep = {profile, compressed, stride};
+  sweep.count = compressed ? 0x10000 : ((1ULL << 32) + stride - 1) / stride;
+  pthread_mutex_init(&sweep.lock, NULL);
+  double start = now_seconds();
+  pthread_t *threads = malloc(nthreads * sizeof(pthread_t));
+  unsigned started = 0;
+  // the calling thread is one of them
+  while (threads && started + 1 < nthreads &&
+         pthread_create(&threads[started], NULL, sweep_thread, &sweep) == 0) {
+    started++;
+  }
+  sweep_thread(&sweep);
+  for (unsigned i = 0; i < started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+  pthread_mutex_destroy(&sweep.lock);
+  printf("%-10s %-6s %12llu compared %10llu mismatches %8.1f s\n",
+         ref_profile_name(profile), compressed ? "16-bit" : "32-bit",
+         (unsigned long long)sweep.compared,
+         (unsigned long long)sweep.mismatches, now_seconds() - start);
+  fflush(stdout);
+  return sweep.mismatches;
+}
+
+int main(int argc, char **argv) {
+  uint64_t stride = argc > 1 ? strtoull(argv[1], NULL, 0) : 1;
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  unsigned nthreads = argc > 2 ? (unsigned)strtoul(argv[2], NULL, 0)
+                      : online > 0 ? (unsigned)online
+                                   : 1;
+  if (stride == 0 || nthreads == 0) {
+    fprintf(stderr, "usage: %s [stride [threads]]\n", argv[0]);
+    return 2;
+  }
+  unsigned ref_ast_size, cand_ast_size;
+  unsigned nprofiles = ref_init(&ref_ast_size);
+  if (nprofiles == 0 || cand_init(&cand_ast_size) != nprofiles) {
+    fprintf(stderr, "can't set up the contexts\n");
+    return 2;
+  }
+  const char *only = getenv("DIFFTEST_PROFILE");
+  if (only != NULL && *only == '\0') {
+    only = NULL;
+  }
+  unsigned named = 0;
+  while (only != NULL && named < nprofiles &&
+         strcmp(only, ref_profile_name(named)) != 0) {
+    named++;
+  }
+  if (named == nprofiles) {
+    fprintf(stderr, "no profile named %s\n", only);
+    return 2;
+  }
+  if (ref_ast_size != cand_ast_size) {
+    printf("struct ast is %u bytes in the reference and %u in the candidate, "
+           "only the ast cases are compared\n",
+           ref_ast_size, cand_ast_size);
+  }
+  ast_size = ref_ast_size == cand_ast_size ? ref_ast_size : 0;
+  printf("32-bit words with a stride of %llu and all 16-bit parcels, on %u "
+         "threads\n",
+         (unsigned long long)stride, nthreads);
+  uint64_t mismatches = 0;
+  for (unsigned p = 0; p < nprofiles; p++) {
+    if (only != NULL && strcmp(only, ref_profile_name(p)) != 0) {
+      continue;
+    }
+    mismatches += run_sweep(p, 1, 1, nthreads);
+    mismatches += run_sweep(p, 0, stride, nthreads);
+  }
+  printf("%llu mismatches\n", (unsigned long long)mismatches);
+  return mismatches != 0;
+}
@@ -0,0 +1,46 @@
+#ifndef __BENCH_DIFFTEST_H__
+#define __BENCH_DIFFTEST_H__
+
+#include <stdint.h>
+
+#include "capstone.h"
+
+// What difftest compares between the reference and the candidate build, for
+// one encoding under one context profile. Each build is compiled in its own
+// translation unit, difftest_side.c, since both define the same functions
+
+#define DIFF_MAX_OPS 16
+#define DIFF_MAX_AST 64
+#define DIFF_MAX_TEXT 512
+
+typedef struct DiffResult {
+  uint16_t case_id;
+  uint16_t insn_type;
+  uint8_t op_count;
+  // the ast as decoded into a zeroed out struct, so that the bytes of the
+  // members a case doesn't use compare equal
+  uint8_t ast[DIFF_MAX_AST];
+  cs_riscv_op ops[DIFF_MAX_OPS];
+  char text[DIFF_MAX_TEXT];
+  // the first optional output of this build that disagrees with its own full
+  // decoder (decode_id(), the control-flow decoders, ast2str_buf()), NULL if
+  // none does or none was generated
+  const char *inconsistent;
+} DiffResult;
+
+// Sets up the contexts of the profiles, returns how many there are and sets
+// *ast_size to sizeof(struct ast) in that build. Returns 0 if it failed, or
+// if the ast is larger than DIFF_MAX_AST
+unsigned ref_init(unsigned *ast_size);
+unsigned cand_init(unsigned *ast_size);
+
+const char *ref_profile_name(unsigned profile);
+
+// Disassembles word, a 16-bit parcel if compressed is set, with the context of
+// the given profile. Safe to call from several threads at once
+void ref_disasm(uint32_t word, int compressed, unsigned profile,
+                DiffResult *out);
+void cand_disasm(uint32_t word, int compressed, unsigned profile,
+                 DiffResult *out);
+
+#endif
@@ -0,0 +1,168 @@
+// One side of difftest, compiled once against the reference copy of the
+// generated code and once against the candidate, with DIFF_SIDE set to ref or
+// cand to name its functions apart
+
+#include <stdio.h>
+#include <string.h>
+
+#include "difftest.h"
+
+// see bench.c, the vector helpers print errors for some vtype values
+#define RISCV_HELPER_ERROR(...) ((void)0)
+
+#include "RISCVAst2Str.gen.inc"
+#include "RISCVDecode.gen.inc"
+#include "RISCVDecodeCompressed.gen.inc"
+#include "RISCVInsnMappings.gen.inc"
+#include "RISCVOperands.gen.inc"
+// The optional outputs that were generated are checked against the full
+// decoder of the same build
+#if __has_include("RISCVDecodeId.gen.inc")
+#include "RISCVDecodeId.gen.inc"
+#endif
+#if __has_include("RISCVControlFlow.gen.inc")
+#include "RISCVControlFlow.h"
+#endif
+#if __has_include("RISCVAst2StrBuf.gen.inc")
+#include "RISCVAst2StrBuf.gen.inc"
+#endif
+#if __has_include("RISCVAstPacked.gen.inc")
+#include "RISCVAstPacked.gen.inc"
+#endif
+
+#define DIFF_CONCAT_(a, b) a##_##b
+#define DIFF_CONCAT(a, b) DIFF_CONCAT_(a, b)
+#define DIFF_NAME(name) DIFF_CONCAT(DIFF_SIDE, name)
+
+typedef struct DiffProfile {
+  const char *name;
+  uint16_t xlen;
+  uint16_t flen;
+  // the enabled extensions follow from these, through
+  // updateEnabledExtensions() where the helpers have it
+  uint32_t misa;
+  uint64_t mstatus;
+  uint64_t extensions_supported;
+} DiffProfile;
+
+#define EXTS_G                                                                \
+  (RISCV_Ext_M | RISCV_Ext_A | RISCV_Ext_F | RISCV_Ext_D | RISCV_Ext_Zifencei | \
+   RISCV_Ext_Zicntr | RISCV_Ext_Zmmul | RISCV_Ext_Zaamo | RISCV_Ext_Zalrsc)
+#define EXTS_C (RISCV_Ext_C | RISCV_Ext_Zca | RISCV_Ext_Zcd)
+#define MISA_GC (MISA_I | MISA_M | MISA_A | MISA_F | MISA_D | MISA_C)
+// the floating-point unit in the Initial state, the vector unit off
+#define MSTATUS_FS_INITIAL (1ULL << 13)
+
+static const DiffProfile profiles[] = {
+    {"rv64 all", 64, 64, ~0u, ~0ULL, ~0ULL},
+    {"rv32 all", 32, 64, ~0u, ~0ULL, ~0ULL},
+    {"rv64gc", 64, 64, MISA_GC, MSTATUS_FS_INITIAL, EXTS_G | EXTS_C},
+    {"rv64i", 64, 0, MISA_I, 0, 0},
+};
+
+#define NUM_PROFILES (sizeof(profiles) / sizeof(profiles[0]))
+
+static RVContext contexts[NUM_PROFILES];
+
+#ifdef DECODE_COMPRESSED_NO_RULE
+// generated with -compressed-table, the 16-bit encodings are decoded through
+// the table of each profile
+static uint8_t compressed_tables[NUM_PROFILES][DECODE_COMPRESSED_TABLE_SIZE];
+#endif
+
+unsigned DIFF_NAME(init)(unsigned *ast_size) {
+  *ast_size = sizeof(struct ast);
+  if (sizeof(struct ast) > DIFF_MAX_AST) {
+    return 0;
+  }
+  for (unsigned i = 0; i < NUM_PROFILES; i++) {
+    RVContext *ctx = &contexts[i];
+    ctx->xlen = profiles[i].xlen;
+    ctx->xlen_bytes = profiles[i].xlen / 8;
+    ctx->flen = profiles[i].flen;
+    ctx->misa = profiles[i].misa;
+    ctx->mstatus = profiles[i].mstatus;
+    ctx->extensionsSupported = profiles[i].extensions_supported;
+    ctx->vtype = 3 << 3;
+    ctx->vl = 4;
+    ctx->vlen = 128;
+    ctx->sp = 2;
+    // a reference saved before the extension mask has no generation either
+#ifdef RISCV_HAVE_ENABLED_EXTENSIONS_MASK
+    updateEnabledExtensions(ctx);
+#endif
+#ifdef DECODE_COMPRESSED_NO_RULE
+    decode_compressed_build_table(compressed_tables[i], ctx);
+#endif
+  }
+  return NUM_PROFILES;
+}
+
+const char *DIFF_NAME(profile_name)(unsigned profile) {
+  return profiles[profile].name;
+}
+
+void DIFF_NAME(disasm)(uint32_t word, int compressed, unsigned profile,
+                       DiffResult *out) {
+  RVContext *ctx = &contexts[profile];
+  struct ast tree;
+  memset(&tree, 0, sizeof(tree));
+  memset(out, 0, sizeof(*out));
+  if (compressed) {
+#ifdef DECODE_COMPRESSED_NO_RULE
+    decode_compressed_from_table(&tree, word, compressed_tables[profile], ctx);
+#else
+    decode_compressed(&tree, word, ctx);
+#endif
+  } else {
+    decode(&tree, word, ctx);
+  }
+  out->case_id = tree.ast_node_type;
+  memcpy(out->ast, &tree, sizeof(tree));
+  out->insn_type = get_insn_type(&tree);
+  fill_operands(&tree, out->ops, &out->op_count);
+  patch_operands(&tree, out->ops, &out->op_count, ctx);
+  SStream ss;
+  SStream_Init(&ss);
+  ast2str(&tree, &ss, ctx);
+  memcpy(out->text, ss.buffer, sizeof(out->text) < sizeof(ss.buffer)
+                                   ? sizeof(out->text)
+                                   : sizeof(ss.buffer));
+  out->text[DIFF_MAX_TEXT - 1] = '\0';
+
+#ifdef DECODE_ID_NO_MATCH
+  uint8_t id_len;
+  if (decode_id(word, ctx, &id_len) != out->insn_type ||
+      id_len != (compressed ? 2 : 4)) {
+    out->inconsistent = "decode_id()";
+  }
+#endif
+#ifdef __RISCV_CONTROL_FLOW_H__
+  // returns 1 for exactly the cases it keeps, with the same tree
+  RVControlFlowInsn cf;
+  memset(&cf, 0, sizeof(cf));
+  uint8_t is_cf = decode_control_flow_insn(word, 0x1000, ctx, &cf);
+  if (is_cf != is_control_flow_case(&tree) ||
+      (is_cf && (cf.length != (compressed ? 2 : 4) ||
+                 memcmp(&cf.tree, &tree, sizeof(tree)) != 0))) {
+    out->inconsistent = "decode_control_flow_insn()";
+  }
+#endif
+#ifdef RISCV_AST2STR_MAX_LEN
+  // ast2str_buf() must render what ast2str() appends
+  char text[RISCV_AST2STR_MAX_LEN + 1];
+  if (ast2str_buf(&tree, text, sizeof(text), ctx) > 0 &&
+      strcmp(text, ss.buffer) != 0) {
+    out->inconsistent = "ast2str_buf()";
+  }
+#endif
+#ifdef PACKED_AST_CASE_BITS
+  // unpack_ast() must give back the tree that pack_ast() packed
+  struct ast unpacked;
+  memset(&unpacked, 0, sizeof(unpacked));
+  unpack_ast(pack_ast(&tree), &unpacked);
+  if (memcmp(&unpacked, &tree, sizeof(tree)) != 0) {
+    out->inconsistent = "pack_ast()";
+  }
+#endif
+}
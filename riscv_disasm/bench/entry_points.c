@@ -0,0 +1,158 @@
+// Calls every entry point of the generated code once, including those of the
+// optional outputs that were generated, so that compiling it with
+// -Wall -Werror catches generated code that is unused or never read : all of
+// it is static, a function or a local that nothing calls or reads is warned
+// about
+//
+// It also checks that the hand-written layers over the decoders, the decode
+// cache and the image input, build along with them and work on a few inputs
+//
+// Build and run with `make warnings` from this directory, see the Makefile. It
+// also builds it with the counters of -decode-stats on
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// generated with -ast2str-buf, first so that nothing else has included
+// SStream.h yet : ast2str_buf() must build without it
+#if __has_include("RISCVAst2StrBuf.gen.inc")
+#include "RISCVAst2StrBuf.gen.inc"
+#ifdef __BENCH_STANDIN_SSTREAM_H__
+#error "RISCVAst2StrBuf.gen.inc includes SStream.h"
+#endif
+#endif
+#include "RISCVAst2Str.gen.inc"
+#include "RISCVDecode.gen.inc"
+#include "RISCVDecodeCompressed.gen.inc"
+#include "RISCVInsnMappings.gen.inc"
+#include "RISCVOperands.gen.inc"
+#define RISCV_DECODE_CACHE_INSN_TYPE
+#define RISCV_DECODE_CACHE_OPERANDS
+#include "RISCVDecodeCache.h"
+#include "RISCVImageInput.h"
+// generated with -decode-id
+#if __has_include("RISCVDecodeId.gen.inc")
+#include "RISCVDecodeId.gen.inc"
+#endif
+// generated with -control-flow
+#if __has_include("RISCVControlFlow.gen.inc")
+#include "RISCVControlFlow.h"
+#endif
+// generated with -operand-columns
+#ifdef RISCV_OPERAND_ROLES
+#include "RISCVDecodeColumns.h"
+#endif
+
+#define MAX_OPS 16
+
+int main(void) {
+  RVContext ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.xlen = 64;
+  ctx.xlen_bytes = 8;
+  ctx.flen = 64;
+  ctx.misa = ~0u;
+  ctx.mstatus = ~0ULL;
+  ctx.extensionsSupported = ~0ULL;
+  updateEnabledExtensions(&ctx);
+
+  // zeroed, the decoders only set the members of the case they decode
+  struct ast tree;
+  memset(&tree, 0, sizeof(tree));
+  decode(&tree, 0x00000013, &ctx);
+  decode_compressed(&tree, 0x0001, &ctx);
+#ifdef DECODE_COMPRESSED_NO_RULE
+  static uint8_t table[DECODE_COMPRESSED_TABLE_SIZE];
+  decode_compressed_build_table(table, &ctx);
+  decode_compressed_from_table(&tree, 0x0001, table, &ctx);
+#endif
+#ifdef DECODE_ID_NO_MATCH
+  uint8_t id_len;
+  printf("%u %u\n", (unsigned)decode_id(0x00000013, &ctx, &id_len),
+         (unsigned)decode_id(0x0001, &ctx, &id_len));
+#endif
+#ifdef __RISCV_CONTROL_FLOW_H__
+  RVControlFlowInsn cf;
+  if (decode_control_flow_insn(0x0000006F, 0x1000, &ctx, &cf)) {
+    printf("%u %llx\n", (unsigned)cf.has_target,
+           (unsigned long long)cf.target);
+  }
+#endif
+
+#ifdef __RISCV_DECODE_COLUMNS_H__
+  // addi x1, x0, -1 then c.nop
+  static const uint8_t block[] = {0x93, 0x00, 0xF0, 0xFF, 0x01, 0x00};
+  uint16_t case_ids[2], insn_ids[2];
+  uint8_t lengths[2], rd[2], rs1[2], rs2[2], rs3[2];
+  uint64_t imm[2];
+  RVDecodedColumns cols = {case_ids, insn_ids, lengths, rd,
+                           rs1,      rs2,      rs3,     imm};
+  size_t decoded;
+  size_t consumed =
+      decode_block_columns(block, sizeof(block), &cols, 2, &decoded, &ctx);
+  printf("%zu %zu %u %lld\n", consumed, decoded, (unsigned)rd[0],
+         (long long)imm[0]);
+#endif
+
+  cs_riscv_op ops[MAX_OPS];
+  uint8_t op_count = 0;
+  fill_operands(&tree, ops, &op_count);
+  patch_operands(&tree, ops, &op_count, &ctx);
+
+  SStream ss;
+  SStream_Init(&ss);
+  ast2str(&tree, &ss, &ctx);
+  printf("%s %u %u\n", ss.buffer, (unsigned)get_insn_type(&tree),
+         (unsigned)op_count);
+#ifdef RISCV_AST2STR_MAX_LEN
+  char text[RISCV_AST2STR_MAX_LEN + 1];
+  ast2str_buf(&tree, text, sizeof(text), &ctx);
+  printf("%s\n", text);
+#endif
+
+  // a miss then a hit in the same generation, and a miss again in the next
+  static RVDecodeCache cache;
+  decode_cache_init(&cache);
+  decode_cached(&cache, 0x00000013, &ctx);
+  decode_cached(&cache, 0x00000013, &ctx);
+  updateEnabledExtensions(&ctx);
+  const RVDecodedInsn *cached = decode_cached(&cache, 0x00000013, &ctx);
+  printf("%u %u\n", (unsigned)cached->insn_type, (unsigned)cached->op_count);
+  if (cache.stats.hits != 1 || cache.stats.misses != 2) {
+    fprintf(stderr, "decode cache: %llu hits and %llu misses\n",
+            (unsigned long long)cache.stats.hits,
+            (unsigned long long)cache.stats.misses);
+    return 1;
+  }
+
+  // a raw image is a single region, loaded at the address it is given
+  static const uint8_t image_bytes[] = {0x13, 0x00, 0x00, 0x00, 0x01, 0x00};
+  char image_path[] = "/tmp/entry_points_image_XXXXXX";
+  int fd = mkstemp(image_path);
+  if (fd < 0 || write(fd, image_bytes, sizeof(image_bytes)) !=
+                    (ssize_t)sizeof(image_bytes)) {
+    perror("entry_points: writing the raw image");
+    return 1;
+  }
+  close(fd);
+  RVImage image;
+  int opened = image_open(image_path, 0x1000, &image);
+  unlink(image_path);
+  if (!opened || image.xlen != 0 || image.nregions != 1 ||
+      image.regions[0].address != 0x1000 ||
+      image.regions[0].len != sizeof(image_bytes) ||
+      memcmp(image.regions[0].data, image_bytes, sizeof(image_bytes)) != 0) {
+    fprintf(stderr, "image_open() didn't map the raw image as one region\n");
+    return 1;
+  }
+  image_release(&image.regions[0], image.regions[0].len);
+  image_close(&image);
+
+#if defined(__RISCV_DECODE_STATS_H__) && defined(RISCV_DECODE_STATS)
+  decode_stats_dump(stdout);
+  decode_stats_reset();
+#endif
+  return 0;
+}
@@ -0,0 +1,148 @@
+// Compares the hex and binary formatting helpers of RISCVAst2StrHelpers.h with
+// the loops they replaced, kept below : both are first checked to produce the
+// same text for every width over random values, then each is timed per width
+//
+// Build and run with `make run-formatters` from this directory, see the
+// Makefile
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "RISCVAst2StrHelpers.h"
+
+#define VALUES 4096
+// every measurement formats at least this many values
+#define MIN_TIMED_CALLS (4u << 20)
+
+static uint64_t values[VALUES];
+
+// The previous hex_bits : one nibble per iteration, into a stack buffer
+static void loop_hex_bits(uint64_t bitvec, uint8_t bvlen_bits, SStream *ss,
+                          RVContext *ctx) {
+  char str[25] = {0};
+  uint8_t str_len = bvlen_bits / 4;
+  if ((bvlen_bits & 0x3) != 0) {
+    str_len++;
+  }
+  str_len += 2;
+  uint8_t len = str_len;
+  for (uint8_t i = 0; i < bvlen_bits; i += 4) {
+    char digit = (bitvec & 0xF) + 48;
+    if (digit > '9') {
+      digit += ('a' - ':');
+    }
+    str[--str_len] = digit;
+    bitvec = bitvec >> 4;
+  }
+  str[0] = '0';
+  str[1] = 'x';
+  ss_append(ss, str, len);
+}
+
+// The previous dec_bits : one SStream_concat1() per bit
+static void loop_dec_bits(uint64_t val, SStream *ss, RVContext *ctx,
+                          uint32_t n) {
+  for (int i = 0; i < n; i++) {
+    uint64_t bit = val & (1ULL << (n - 1 - i));
+    SStream_concat1(ss, (bit == 0) ? '0' : '1');
+  }
+}
+
+typedef void (*Formatter)(uint64_t val, uint8_t bits, SStream *ss,
+                          RVContext *ctx);
+
+static void swar_hex(uint64_t val, uint8_t bits, SStream *ss, RVContext *ctx) {
+  hex_bits(val, bits, ss, ctx);
+}
+
+static void loop_hex(uint64_t val, uint8_t bits, SStream *ss, RVContext *ctx) {
+  loop_hex_bits(val, bits, ss, ctx);
+}
+
+static void swar_bin(uint64_t val, uint8_t bits, SStream *ss, RVContext *ctx) {
+  dec_bits(val, ss, ctx, bits);
+}
+
+static void loop_bin(uint64_t val, uint8_t bits, SStream *ss, RVContext *ctx) {
+  loop_dec_bits(val, ss, ctx, bits);
+}
+
+static double now_ns(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// Returns the number of values formatted differently
+static unsigned check(Formatter a, Formatter b, uint8_t bits) {
+  unsigned differences = 0;
+  for (size_t i = 0; i < VALUES; i++) {
+    SStream sa, sb;
+    SStream_Init(&sa);
+    SStream_Init(&sb);
+    a(values[i], bits, &sa, NULL);
+    b(values[i], bits, &sb, NULL);
+    if (strcmp(sa.buffer, sb.buffer) != 0 && differences++ == 0) {
+      printf("  %u bits, 0x%llx: \"%s\" and \"%s\"\n", bits,
+             (unsigned long long)values[i], sa.buffer, sb.buffer);
+    }
+  }
+  return differences;
+}
+
+// Returns the ns per call, the stream is reset every 16 values so that the
+// appends stay in its first cache lines
+static double time_formatter(Formatter f, uint8_t bits) {
+  SStream ss;
+  size_t calls = 0;
+  uint64_t checksum = 0;
+  double start = now_ns();
+  while (calls < MIN_TIMED_CALLS) {
+    for (size_t i = 0; i < VALUES; i++) {
+      if (i % 16 == 0) {
+        SStream_Init(&ss);
+      }
+      f(values[i], bits, &ss, NULL);
+      checksum += ss.index;
+    }
+    calls += VALUES;
+  }
+  double ns = (now_ns() - start) / calls;
+  // keeps the calls from being optimized out
+  if (checksum == 0) {
+    printf("nothing formatted\n");
+  }
+  return ns;
+}
+
+static unsigned run(const char *name, Formatter loop, Formatter swar,
+                    uint8_t max_bits) {
+  printf("%s\n%6s %10s %10s %8s\n", name, "bits", "loop ns", "swar ns",
+         "speedup");
+  unsigned differences = 0;
+  for (uint8_t bits = 1; bits <= max_bits; bits++) {
+    differences += check(loop, swar, bits);
+    double loop_ns = time_formatter(loop, bits);
+    double swar_ns = time_formatter(swar, bits);
+    printf("%6u %10.2f %10.2f %7.2fx\n", bits, loop_ns, swar_ns,
+           swar_ns > 0 ? loop_ns / swar_ns : 0.0);
+  }
+  printf("\n");
+  return differences;
+}
+
+int main(void) {
+  uint64_t state = 88172645463325252ULL;
+  for (size_t i = 0; i < VALUES; i++) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    values[i] = state;
+  }
+  unsigned differences = run("hex_bits", loop_hex, swar_hex, 64);
+  differences += run("dec_bits", loop_bin, swar_bin, 64);
+  printf("%u values formatted differently\n", differences);
+  return differences != 0;
+}
@@ -0,0 +1,30 @@
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "SStream.h"
+
+void SStream_Init(SStream *ss) {
+  ss->index = 0;
+  ss->buffer[0] = '\0';
+}
+
+void SStream_concat(SStream *ss, const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  int ret = vsnprintf(ss->buffer + ss->index, sizeof(ss->buffer) - ss->index,
+                      fmt, ap);
+  va_end(ap);
+  if (ret > 0) {
+    ss->index += ret;
+    if (ss->index >= (int)sizeof(ss->buffer)) {
+      ss->index = sizeof(ss->buffer) - 1;
+    }
+  }
+}
+
+void SStream_concat1(SStream *ss, const char c) {
+  if (ss->index < (int)sizeof(ss->buffer) - 1) {
+    ss->buffer[ss->index++] = c;
+    ss->buffer[ss->index] = '\0';
+  }
+}
@@ -0,0 +1,18 @@
+#ifndef __BENCH_STANDIN_SSTREAM_H__
+#define __BENCH_STANDIN_SSTREAM_H__
+
+// The subset of Capstone's SStream that the generated code uses, so that it
+// builds without a Capstone checkout
+
+typedef struct SStream {
+  char buffer[512];
+  int index;
+} SStream;
+
+void SStream_Init(SStream *ss);
+
+void SStream_concat(SStream *ss, const char *fmt, ...);
+
+void SStream_concat1(SStream *ss, const char c);
+
+#endif
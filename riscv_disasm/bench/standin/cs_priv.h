@@ -0,0 +1,7 @@
+#ifndef __BENCH_STANDIN_CS_PRIV_H__
+#define __BENCH_STANDIN_CS_PRIV_H__
+
+// Capstone only checks its assertions in debug builds
+#define CS_ASSERT(expr)
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef __BENCH_STANDIN_CAPSTONE_H__
+#define __BENCH_STANDIN_CAPSTONE_H__
+
+#include <stdint.h>
+
+// The RISC-V operand types of Capstone, laid out like in its riscv.h
+
+typedef enum cs_ac_type {
+  CS_AC_INVALID = 0,
+  CS_AC_READ = 1 << 0,
+  CS_AC_WRITE = 1 << 1,
+} cs_ac_type;
+
+typedef enum riscv_op_type {
+  RISCV_OP_INVALID = 0,
+  RISCV_OP_REG,
+  RISCV_OP_IMM,
+  RISCV_OP_MEM,
+} riscv_op_type;
+
+// whether the address of a memory operand is only known at run time
+enum { RISCV_OP_MEM_RUNTIME = 1 };
+
+typedef struct riscv_op_mem {
+  unsigned int base;
+  int64_t disp;
+  uint8_t type;
+} riscv_op_mem;
+
+typedef struct cs_riscv_op {
+  riscv_op_type type;
+  union {
+    unsigned int reg;
+    int64_t imm;
+    riscv_op_mem mem;
+  };
+  uint8_t access;
+} cs_riscv_op;
+
+#endif